@@ -0,0 +1,24 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "thread_queue.h"
+
+#define AUDIO_RAMP_SAMPLES 64
+#define AUDIO_DRIFT_DIVISOR 50
+
+typedef struct {
+    uint32_t sample_rate;
+    uint32_t target_fill;
+    uint32_t sample_remainder;
+    uint32_t phase;
+    int32_t level;
+    bool high;
+} beeper_object;
+
+void init_beeper(beeper_object *beeper, audio_ring_object *ring, uint32_t sample_rate, uint32_t device_samples);
+uint32_t generate_audio(beeper_object *beeper, audio_ring_object *ring, bool sounding);
+
+#endif
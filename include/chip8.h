@@ -2,25 +2,63 @@
 #define CHIP8_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define WINDOW_HEIGHT 32
 #define WINDOW_WIDTH 64
 #define WINDOW_SCALE_FACTOR 20
 #define WINDOW_HERTZ 60
-#define WINDOW_UPDATE_MS 1000 / WINDOW_HERTZ
+#define WINDOW_UPDATE_MS (1000 / WINDOW_HERTZ)
 #define PIXEL_OUTLINE false
 #define INSTRUCTIONS_PER_SECOND 700
 #define SOUND_WAVE_FREQUENCY 440
 #define AUDIO_SAMPLE_RATE 44100
 #define VOLUME 3000
+#define DISPLAY_WIDTH 128
+#define DISPLAY_HEIGHT 64
+#define DISPLAY_WORDS (DISPLAY_WIDTH / 64)
+#define DISPLAY_PLANES 2
+#define MEMORY_SIZE 65536
+#define FONT_ADDRESS 0x000
+#define BIG_FONT_ADDRESS 0x050
+#define ENTRYPOINT 0x200
+#define MAX_ROM_SIZE (MEMORY_SIZE - ENTRYPOINT)
+#define RAM_BLOCK_SIZE 64
+#define RAM_BLOCKS (MEMORY_SIZE / RAM_BLOCK_SIZE)
+#define RAM_DIRTY_WORDS (RAM_BLOCKS / 64)
+#define IDLE_LOOP_LIMIT 8
+#define QUIRK_VF_RESET 0x01
+#define QUIRK_MEMORY_INCREMENT 0x02
+#define QUIRK_SHIFT_VX 0x04
+#define QUIRK_JUMP_VX 0x08
+#define QUIRK_CLIPPING 0x10
+#define QUIRK_LONG_SKIP 0x20
+#define SCREEN_WIDTH(hires) ((hires) ? DISPLAY_WIDTH : WINDOW_WIDTH)
+#define SCREEN_HEIGHT(hires) ((hires) ? DISPLAY_HEIGHT : WINDOW_HEIGHT)
+#define DISPLAY_PIXEL(display, x, y) ((((display)[y][(x) / 64]) >> (63 - (x) % 64)) & 1)
 
 typedef enum {
     QUIT,
     RUNNING,
-    PAUSED
+    PAUSED,
+    REWINDING
 } emulator_state;
 
+typedef enum {
+    QUIRKS_VIP,
+    QUIRKS_CHIP48,
+    QUIRKS_SCHIP,
+    QUIRKS_XOCHIP,
+    QUIRKS_COUNT
+} quirk_profile;
+
+#define QUIRK_PROFILES(X) \
+    X(QUIRKS_VIP, vip, QUIRK_VF_RESET | QUIRK_MEMORY_INCREMENT | QUIRK_CLIPPING) \
+    X(QUIRKS_CHIP48, chip48, QUIRK_MEMORY_INCREMENT | QUIRK_SHIFT_VX | QUIRK_JUMP_VX | QUIRK_CLIPPING) \
+    X(QUIRKS_SCHIP, schip, QUIRK_SHIFT_VX | QUIRK_JUMP_VX | QUIRK_CLIPPING) \
+    X(QUIRKS_XOCHIP, xochip, QUIRK_MEMORY_INCREMENT | QUIRK_LONG_SKIP)
+
 typedef struct {
     uint16_t opcode;
     uint16_t NNN;
@@ -30,10 +68,25 @@ typedef struct {
     uint8_t Y;
 } instruction_object;
 
+typedef struct {
+    uint32_t instructions_per_second;
+    uint32_t remainder;
+} instruction_rate_object;
+
+typedef struct {
+    uint32_t settle;
+    uint32_t length;
+} idle_loop_object;
+
 typedef struct {
     emulator_state state;
-    uint8_t ram[4096];
-    bool display[WINDOW_HEIGHT * WINDOW_WIDTH];
+    uint8_t ram[MEMORY_SIZE];
+    uint64_t ram_dirty[RAM_DIRTY_WORDS];
+    uint64_t display[DISPLAY_PLANES][DISPLAY_HEIGHT][DISPLAY_WORDS];
+    uint64_t dirty_rows;
+    bool hires;
+    uint8_t planes;
+    uint8_t rpl[16];
     uint16_t stack[12];
     uint16_t *stack_pointer;
     uint8_t V[16];
@@ -42,11 +95,49 @@ typedef struct {
     uint8_t delay_timer;
     uint8_t sound_timer;
     bool keypad[16];
+    bool key_pending;
+    uint8_t pending_key;
     const char *rom_name;
-    instruction_object instruction;
+    uint64_t rom_hash;
+    uint32_t rng_state;
+    uint32_t restore_count;
+    quirk_profile quirks;
+#ifdef CHIP8_PROFILE
+    struct profile_object *profile;
+#endif
+#ifdef CHIP8_TRACE
+    struct trace_object *trace;
+#endif
 } chip8_object;
 
+struct debugger_object;
+
+typedef void (*interpreter_function)(chip8_object *chip8);
+typedef uint32_t (*debug_interpreter_function)(chip8_object *chip8, struct debugger_object *debugger, uint32_t count);
+
 bool init_chip8(chip8_object *chip8, const char rom_name[]);
+bool load_chip8(chip8_object *chip8, const uint8_t *rom, size_t rom_size, const char rom_name[]);
+void seed_chip8(chip8_object *chip8, uint32_t seed);
 void emulate_instruction(chip8_object *chip8);
+interpreter_function select_interpreter(quirk_profile profile);
+debug_interpreter_function select_debug_interpreter(quirk_profile profile);
+uint32_t quirk_flags(quirk_profile profile);
+bool parse_quirk_profile(const char *name, quirk_profile *profile);
+const char *quirk_profile_name(quirk_profile profile);
+bool parse_count(const char *text, uint64_t minimum, uint64_t maximum, uint64_t *count);
+uint8_t random_byte(chip8_object *chip8);
+void mark_ram_dirty(chip8_object *chip8, uint16_t first, uint16_t last);
+void clear_ram_dirty(chip8_object *chip8);
+void clear_display(chip8_object *chip8);
+void draw_sprite(chip8_object *chip8, uint8_t x, uint8_t y, uint8_t height);
+void draw_sprite_wrapped(chip8_object *chip8, uint8_t x, uint8_t y, uint8_t height);
+void scroll_display_rows(chip8_object *chip8, int32_t rows);
+void scroll_display_columns(chip8_object *chip8, int32_t columns);
+void set_resolution(chip8_object *chip8, bool hires);
+void tick_timers(chip8_object *chip8);
+uint32_t frame_instructions(instruction_rate_object *rate);
+bool find_idle_loop(const chip8_object *chip8, idle_loop_object *loop);
+uint64_t hash_display(const chip8_object *chip8);
+bool compare_chip8(const chip8_object *first, const chip8_object *second);
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define DEBUG_WORDS (MEMORY_SIZE / 64)
+#define DEBUG_REGISTER_I 16
+#define DEBUG_TEXT_SIZE 32
+
+typedef enum {
+    DEBUG_NONE,
+    DEBUG_BREAKPOINT,
+    DEBUG_WATCHPOINT,
+    DEBUG_REGISTER,
+    DEBUG_STEP
+} debug_stop_reason;
+
+typedef struct debugger_object {
+    uint64_t breakpoints[DEBUG_WORDS];
+    uint64_t watchpoints[DEBUG_WORDS];
+    uint32_t breakpoint_count;
+    uint32_t watchpoint_count;
+    uint32_t watched_registers;
+    uint64_t steps;
+    bool resuming;
+    debug_stop_reason reason;
+    uint16_t stop_address;
+    uint8_t stop_register;
+    uint32_t executed;
+} debugger_object;
+
+static inline bool debug_bit(const uint64_t *bits, uint16_t address)
+{
+    return (bits[address / 64] >> (address % 64)) & 1;
+}
+
+static inline bool debugger_armed(const debugger_object *debugger)
+{
+    return debugger->breakpoint_count || debugger->watchpoint_count || debugger->watched_registers || debugger->steps;
+}
+
+void init_debugger(debugger_object *debugger);
+bool set_breakpoint(debugger_object *debugger, uint16_t address, bool enabled);
+void set_watchpoint(debugger_object *debugger, uint16_t address, uint16_t length, bool enabled);
+void watch_register(debugger_object *debugger, uint8_t index, bool enabled);
+void resume_debugger(debugger_object *debugger, uint64_t steps);
+uint32_t run_debugger(debugger_object *debugger, chip8_object *chip8, uint32_t count);
+uint16_t disassemble_instruction(const uint8_t *ram, uint16_t address, char *text, size_t size);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "jit.h"
+#include "threaded.h"
+
+typedef enum {
+    ENGINE_SWITCH,
+    ENGINE_THREADED,
+    ENGINE_JIT
+} engine_type;
+
+typedef struct {
+    engine_type type;
+    uint32_t restore_count;
+    struct debugger_object *debugger;
+    bool debugging;
+    threaded_object threaded;
+    jit_object jit;
+} engine_object;
+
+bool parse_engine_type(const char *name, engine_type *type);
+bool init_engine(engine_object *engine, engine_type type);
+void destroy_engine(engine_object *engine);
+void reset_engine(engine_object *engine);
+bool run_engine(engine_object *engine, chip8_object *chip8, uint32_t count);
+
+#endif
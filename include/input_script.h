@@ -0,0 +1,39 @@
+#ifndef INPUT_SCRIPT_H
+#define INPUT_SCRIPT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+typedef struct {
+    uint32_t frame;
+    uint8_t key;
+    bool pressed;
+} input_event_object;
+
+typedef struct {
+    input_event_object *events;
+    size_t count;
+    size_t capacity;
+} input_script_object;
+
+typedef struct {
+    uint32_t seed;
+    uint32_t instructions_per_second;
+    uint32_t frame_count;
+    quirk_profile quirks;
+    uint64_t rom_hash;
+    input_script_object script;
+} movie_object;
+
+bool load_input_script(input_script_object *script, const char *path);
+bool append_input_event(input_script_object *script, uint32_t frame, uint8_t key, bool pressed);
+void free_input_script(input_script_object *script);
+size_t apply_input_script(const input_script_object *script, size_t cursor, uint32_t frame, bool keypad[16]);
+bool record_keypad_changes(input_script_object *script, uint32_t frame, bool previous[16], const bool keypad[16]);
+bool save_movie(const movie_object *movie, const char *path);
+bool load_movie(movie_object *movie, const char *path);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef INSTANCE_POOL_H
+#define INSTANCE_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define POOL_PAGE_SIZE 256
+#define POOL_PAGES (MEMORY_SIZE / POOL_PAGE_SIZE)
+#define POOL_PAGE_WORDS (POOL_PAGES / 64)
+#define POOL_PAGE_BLOCKS (POOL_PAGE_SIZE / RAM_BLOCK_SIZE)
+
+typedef struct {
+    uint8_t (*pages)[POOL_PAGE_SIZE];
+    uint64_t (*display)[DISPLAY_HEIGHT][DISPLAY_WORDS];
+    uint64_t private_pages[POOL_PAGE_WORDS];
+    uint64_t lores[WINDOW_HEIGHT];
+    uint64_t dirty_rows;
+    uint32_t rng_state;
+    uint16_t stack[12];
+    uint16_t I;
+    uint16_t program_counter;
+    uint16_t keypad;
+    uint8_t V[16];
+    uint8_t rpl[16];
+    uint8_t stack_depth;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    uint8_t pending_key;
+    uint8_t planes;
+    uint8_t state;
+    bool hires;
+    bool key_pending;
+} compact_chip8_object;
+
+typedef struct {
+    uint8_t image[MEMORY_SIZE];
+    compact_chip8_object *instances;
+    uint32_t count;
+    quirk_profile quirks;
+    const char *rom_name;
+} instance_pool_object;
+
+bool init_instance_pool(instance_pool_object *pool, const chip8_object *prototype, uint32_t count);
+void destroy_instance_pool(instance_pool_object *pool);
+void init_pool_worker(const instance_pool_object *pool, chip8_object *chip8);
+void load_compact_chip8(const instance_pool_object *pool, const compact_chip8_object *instance, chip8_object *chip8);
+bool store_compact_chip8(const instance_pool_object *pool, compact_chip8_object *instance, const chip8_object *chip8);
+void release_compact_chip8(compact_chip8_object *instance);
+uint64_t hash_compact_chip8(const compact_chip8_object *instance);
+void checkout_instance(const instance_pool_object *pool, uint32_t index, chip8_object *chip8);
+bool checkin_instance(instance_pool_object *pool, uint32_t index, chip8_object *chip8);
+size_t instance_pool_memory(const instance_pool_object *pool);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+typedef struct {
+    uint8_t *arena;
+    size_t arena_size;
+    size_t arena_used;
+    uint32_t block_offset[MEMORY_SIZE];
+    uint8_t block_length[MEMORY_SIZE];
+    bool code_map[MEMORY_SIZE];
+    quirk_profile quirks;
+} jit_object;
+
+bool init_jit(jit_object *jit);
+void destroy_jit(jit_object *jit);
+void reset_jit(jit_object *jit);
+void run_jit(jit_object *jit, chip8_object *chip8, uint32_t count);
+
+#endif
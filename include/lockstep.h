@@ -0,0 +1,36 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define LOCKSTEP_MAX_INSTANCES 64
+#define LOCKSTEP_VECTOR_SIZE 32
+
+typedef struct {
+    uint8_t V[16][LOCKSTEP_MAX_INSTANCES] __attribute__((aligned(LOCKSTEP_VECTOR_SIZE)));
+    uint16_t I[LOCKSTEP_MAX_INSTANCES] __attribute__((aligned(LOCKSTEP_VECTOR_SIZE)));
+    uint16_t program_counter[LOCKSTEP_MAX_INSTANCES] __attribute__((aligned(LOCKSTEP_VECTOR_SIZE)));
+    uint8_t byte_mask[LOCKSTEP_MAX_INSTANCES] __attribute__((aligned(LOCKSTEP_VECTOR_SIZE)));
+    uint16_t word_mask[LOCKSTEP_MAX_INSTANCES] __attribute__((aligned(LOCKSTEP_VECTOR_SIZE)));
+    uint64_t mask_group;
+    uint32_t count;
+    uint64_t lanes;
+    uint64_t synced_lanes;
+    uint64_t code_dirty[RAM_DIRTY_WORDS];
+    uint32_t quirks;
+    interpreter_function interpret;
+    uint64_t vector_steps;
+    uint64_t scalar_steps;
+    chip8_object *instances;
+} lockstep_object;
+
+bool init_lockstep(lockstep_object *lockstep, const chip8_object *prototype, uint32_t count);
+void destroy_lockstep(lockstep_object *lockstep);
+void run_lockstep(lockstep_object *lockstep, uint32_t count);
+void tick_lockstep_timers(lockstep_object *lockstep);
+chip8_object *sync_lockstep_instance(lockstep_object *lockstep, uint32_t index);
+
+#endif
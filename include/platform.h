@@ -5,20 +5,26 @@
 
 #include "SDL.h"
 #include "chip8.h"
+#include "thread_queue.h"
+
+#define PAUSED_WAIT_MS 100
 
 typedef struct {
     SDL_Window *window;
     SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    bool presented_hires;
+    bool presented_valid;
     SDL_AudioSpec want;
     SDL_AudioSpec have;
     SDL_AudioDeviceID device;
 } sdl_object;
 
-bool init_sdl(sdl_object *sdl);
+bool init_sdl(sdl_object *sdl, audio_ring_object *audio);
 void cleanup(const sdl_object *sdl);
 void clear_screen(const sdl_object *sdl);
-void update_screen(const sdl_object *sdl, const chip8_object *chip8);
-void update_timers(const sdl_object *sdl, chip8_object *chip8);
-void handle_input(chip8_object *chip8);
+bool update_screen(sdl_object *sdl, const frame_object *frame);
+void pause_audio(const sdl_object *sdl, bool paused);
+bool handle_input(input_queue_object *queue, int32_t timeout_ms);
 
 #endif
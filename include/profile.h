@@ -0,0 +1,65 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+
+#define PROFILE_HOT_ADDRESSES 16
+
+typedef struct {
+    uint64_t frames;
+    uint64_t missed;
+    double emulate_ms;
+    double publish_ms;
+    double sleep_ms;
+    double frame_ms;
+    double max_emulate_ms;
+    double max_publish_ms;
+    double max_frame_ms;
+} frame_stats_object;
+
+typedef struct {
+    atomic_uint_fast64_t frames;
+    atomic_uint_fast64_t total_ns;
+    atomic_uint_fast64_t max_ns;
+} render_stats_object;
+
+typedef struct profile_object {
+    uint64_t instructions;
+    uint64_t family_counts[16];
+    uint64_t address_hits[MEMORY_SIZE];
+    frame_stats_object total;
+    frame_stats_object window;
+    render_stats_object render_total;
+    render_stats_object render_window;
+} profile_object;
+
+#ifdef CHIP8_PROFILE
+#define PROFILE_INSTRUCTION(chip8, address)                                     \
+    do {                                                                        \
+        if ((chip8)->profile) {                                                 \
+            profile_instruction((chip8)->profile, (chip8)->ram, (address));     \
+        }                                                                       \
+    } while (0)
+#else
+#define PROFILE_INSTRUCTION(chip8, address) ((void)0)
+#endif
+
+static inline void profile_instruction(profile_object *profile, const uint8_t *ram, uint16_t address)
+{
+    address &= MEMORY_SIZE - 1;
+
+    profile->instructions++;
+    profile->family_counts[ram[address] >> 4]++;
+    profile->address_hits[address]++;
+}
+
+void record_frame(profile_object *profile, double emulate_ms, double publish_ms, double sleep_ms, double frame_ms);
+void record_render(profile_object *profile, uint64_t render_ns);
+void print_profile_line(profile_object *profile, FILE *file);
+void print_profile_report(const profile_object *profile, const chip8_object *chip8, FILE *file);
+
+#endif
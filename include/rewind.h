@@ -0,0 +1,49 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define REWIND_DEFAULT_SECONDS 60
+#define REWIND_DEFAULT_BUDGET (8 * 1024 * 1024)
+
+typedef struct {
+    uint16_t stack[12];
+    uint8_t stack_index;
+    uint8_t V[16];
+    uint16_t I;
+    uint16_t program_counter;
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    bool key_pending;
+    uint8_t pending_key;
+    uint32_t rng_state;
+    bool hires;
+    uint8_t planes;
+    uint8_t rpl[16];
+} rewind_registers_object;
+
+typedef struct {
+    uint8_t *buffer;
+    uint8_t *record;
+    size_t capacity;
+    size_t head;
+    size_t used;
+    uint32_t frame_count;
+    uint32_t max_frames;
+    bool primed;
+    uint32_t restore_count;
+    rewind_registers_object registers;
+    uint8_t ram[MEMORY_SIZE];
+    uint64_t display[DISPLAY_PLANES][DISPLAY_HEIGHT][DISPLAY_WORDS];
+} rewind_object;
+
+bool init_rewind(rewind_object *rewind, size_t budget, uint32_t max_frames);
+void destroy_rewind(rewind_object *rewind);
+void capture_rewind(rewind_object *rewind, chip8_object *chip8);
+bool step_rewind(rewind_object *rewind, chip8_object *chip8);
+
+#endif
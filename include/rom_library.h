@@ -0,0 +1,47 @@
+#ifndef ROM_LIBRARY_H
+#define ROM_LIBRARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROM_NAME_LENGTH 64
+#define ROM_QUIRKS_LENGTH 16
+#define ROM_LIBRARY_METADATA "library.txt"
+#define ROM_ARCHIVE_VERSION 1
+
+typedef struct {
+    uint32_t instructions_per_second;
+    char quirks[ROM_QUIRKS_LENGTH];
+} rom_metadata_object;
+
+typedef struct {
+    uint64_t hash;
+    const uint8_t *data;
+    uint32_t size;
+    char name[ROM_NAME_LENGTH];
+    rom_metadata_object metadata;
+} rom_entry_object;
+
+typedef struct {
+    void *address;
+    size_t size;
+} rom_mapping_object;
+
+typedef struct {
+    rom_entry_object *entries;
+    size_t count;
+    rom_mapping_object *mappings;
+    size_t mapping_count;
+} rom_library_object;
+
+uint64_t hash_rom(const uint8_t *data, size_t size);
+bool map_rom_file(rom_mapping_object *mapping, const char *path);
+void unmap_rom_file(rom_mapping_object *mapping);
+bool open_rom_library(rom_library_object *library, const char *path);
+void close_rom_library(rom_library_object *library);
+bool load_rom_metadata(rom_library_object *library, const char *path);
+const rom_entry_object *find_rom(const rom_library_object *library, const char *key);
+bool pack_rom_library(const rom_library_object *library, const char *path);
+
+#endif
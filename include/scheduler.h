@@ -0,0 +1,22 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "SDL.h"
+#include "chip8.h"
+
+typedef struct {
+    uint64_t frequency;
+    uint64_t origin;
+    uint64_t frame;
+    uint64_t spin_ticks;
+    uint64_t missed;
+} scheduler_object;
+
+void init_scheduler(scheduler_object *scheduler);
+void reset_scheduler(scheduler_object *scheduler);
+bool wait_next_frame(scheduler_object *scheduler, bool idle);
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define SNAPSHOT_VERSION 4
+#define SNAPSHOT_MAX_SIZE (160 + MEMORY_SIZE + DISPLAY_PLANES * DISPLAY_HEIGHT * DISPLAY_WORDS * 8)
+#define SNAPSHOT_SLOTS 4
+
+typedef enum {
+    SNAPSHOT_FULL,
+    SNAPSHOT_DELTA
+} snapshot_kind;
+
+size_t chip8_snapshot(const chip8_object *chip8, uint8_t *buffer, size_t size);
+size_t chip8_snapshot_delta(const chip8_object *chip8, const chip8_object *previous, uint8_t *buffer, size_t size);
+bool chip8_restore(chip8_object *chip8, const uint8_t *buffer, size_t size);
+bool save_snapshot_file(const chip8_object *chip8, const char *path);
+bool load_snapshot_file(chip8_object *chip8, const char *path);
+
+#endif
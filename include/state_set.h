@@ -0,0 +1,27 @@
+#ifndef STATE_SET_H
+#define STATE_SET_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    _Atomic uint64_t *slots;
+    uint64_t mask;
+    atomic_size_t count;
+    size_t limit;
+} state_set_object;
+
+typedef enum {
+    STATE_ADDED,
+    STATE_PRESENT,
+    STATE_FULL
+} state_insert_result;
+
+bool init_state_set(state_set_object *set, size_t limit);
+void destroy_state_set(state_set_object *set);
+state_insert_result insert_state(state_set_object *set, uint64_t hash);
+size_t state_set_size(state_set_object *set);
+
+#endif
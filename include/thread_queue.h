@@ -0,0 +1,71 @@
+#ifndef THREAD_QUEUE_H
+#define THREAD_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define INPUT_QUEUE_SIZE 256
+#define AUDIO_RING_SIZE 8192
+#define CACHE_LINE_SIZE 64
+
+typedef enum {
+    INPUT_KEY_DOWN,
+    INPUT_KEY_UP,
+    INPUT_TOGGLE_PAUSE,
+    INPUT_REWIND_START,
+    INPUT_REWIND_STOP,
+    INPUT_SAVE_SLOT,
+    INPUT_LOAD_SLOT
+} input_command_type;
+
+typedef struct {
+    input_command_type type;
+    uint8_t value;
+} input_command_object;
+
+typedef struct {
+    input_command_object commands[INPUT_QUEUE_SIZE];
+    _Alignas(CACHE_LINE_SIZE) atomic_uint head;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint tail;
+} input_queue_object;
+
+typedef struct {
+    uint64_t display[DISPLAY_PLANES][DISPLAY_HEIGHT][DISPLAY_WORDS];
+    uint64_t dirty_rows;
+    bool hires;
+    emulator_state state;
+    uint64_t frame;
+} frame_object;
+
+typedef struct {
+    int16_t samples[AUDIO_RING_SIZE];
+    _Alignas(CACHE_LINE_SIZE) atomic_uint head;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint tail;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint underruns;
+} audio_ring_object;
+
+typedef struct {
+    frame_object frames[3];
+    _Alignas(CACHE_LINE_SIZE) atomic_uint middle;
+    _Alignas(CACHE_LINE_SIZE) uint32_t back;
+    _Alignas(CACHE_LINE_SIZE) uint32_t front;
+} triple_buffer_object;
+
+void init_input_queue(input_queue_object *queue);
+bool push_input(input_queue_object *queue, input_command_object command);
+bool pop_input(input_queue_object *queue, input_command_object *command);
+
+void init_audio_ring(audio_ring_object *ring);
+uint32_t audio_ring_fill(audio_ring_object *ring);
+uint32_t push_audio(audio_ring_object *ring, const int16_t *samples, uint32_t count);
+uint32_t pop_audio(audio_ring_object *ring, int16_t *samples, uint32_t count);
+
+void init_triple_buffer(triple_buffer_object *buffer);
+frame_object *back_frame(triple_buffer_object *buffer);
+bool publish_frame(triple_buffer_object *buffer);
+const frame_object *acquire_frame(triple_buffer_object *buffer);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef THREADED_H
+#define THREADED_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+typedef struct {
+    uint8_t handler;
+    uint8_t X;
+    uint8_t Y;
+    uint8_t NN;
+    uint16_t NNN;
+} decoded_object;
+
+typedef struct {
+    decoded_object table[MEMORY_SIZE];
+    quirk_profile quirks;
+} threaded_object;
+
+void reset_threaded(threaded_object *threaded);
+void run_threaded(threaded_object *threaded, chip8_object *chip8, uint32_t count);
+
+#endif
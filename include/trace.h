@@ -0,0 +1,104 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.h"
+#include "thread_queue.h"
+
+#define TRACE_VERSION 1
+#define TRACE_RING_RECORDS 65536
+#define TRACE_PUBLISH_INTERVAL 256
+#define TRACE_BLOCK_RECORDS 4096
+#define TRACE_RECORD_MAX_BYTES 9
+#define TRACE_FLUSH_WAIT_US 1000
+
+typedef struct {
+    uint16_t program_counter;
+    uint16_t opcode;
+    uint16_t I;
+    uint8_t VX;
+    uint8_t VF;
+} trace_record_object;
+
+typedef struct {
+    uint16_t opcodes[MEMORY_SIZE];
+    uint16_t program_counter;
+    uint16_t I;
+    uint8_t V[16];
+} trace_codec_object;
+
+typedef struct trace_object {
+    trace_record_object records[TRACE_RING_RECORDS];
+    uint32_t head;
+    uint32_t tail_seen;
+    uint64_t stalls;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint published;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint tail;
+    atomic_bool stopping;
+    FILE *file;
+    pthread_t flusher;
+    trace_codec_object codec;
+    uint8_t block[TRACE_BLOCK_RECORDS * TRACE_RECORD_MAX_BYTES];
+    uint64_t records_written;
+    uint64_t bytes_written;
+    bool failed;
+} trace_object;
+
+typedef struct {
+    FILE *file;
+    trace_codec_object codec;
+    uint8_t block[TRACE_BLOCK_RECORDS * TRACE_RECORD_MAX_BYTES];
+    uint32_t block_records;
+    uint32_t block_size;
+    uint32_t cursor;
+    uint32_t offset;
+    uint64_t index;
+    quirk_profile quirks;
+    char rom_name[256];
+    bool corrupt;
+} trace_reader_object;
+
+#ifdef CHIP8_TRACE
+#define TRACE_INSTRUCTION(chip8, address, instruction)                          \
+    do {                                                                        \
+        if ((chip8)->trace) {                                                   \
+            trace_instruction((chip8)->trace, chip8, address, instruction);     \
+        }                                                                       \
+    } while (0)
+#else
+#define TRACE_INSTRUCTION(chip8, address, instruction) ((void)(address))
+#endif
+
+void wait_trace_space(trace_object *trace);
+
+static inline void trace_instruction(trace_object *trace, const chip8_object *chip8, uint16_t address, const instruction_object *instruction)
+{
+    if (trace->head - trace->tail_seen == TRACE_RING_RECORDS) {
+        wait_trace_space(trace);
+    }
+
+    trace->records[trace->head % TRACE_RING_RECORDS] = (trace_record_object){
+        .program_counter = address,
+        .opcode = instruction->opcode,
+        .I = chip8->I,
+        .VX = chip8->V[instruction->X],
+        .VF = chip8->V[0xF]
+    };
+
+    if (++trace->head % TRACE_PUBLISH_INTERVAL == 0) {
+        atomic_store_explicit(&trace->published, trace->head, memory_order_release);
+    }
+}
+
+bool start_trace(trace_object *trace, const char *path, const chip8_object *chip8);
+bool stop_trace(trace_object *trace);
+bool open_trace(trace_reader_object *reader, const char *path);
+bool read_trace(trace_reader_object *reader, trace_record_object *record);
+void close_trace(trace_reader_object *reader);
+
+#endif
@@ -0,0 +1,85 @@
+#include "audio.h"
+
+#define AUDIO_CHUNK 256
+
+static uint32_t frame_samples(beeper_object *beeper)
+{
+    const uint32_t total = beeper->sample_remainder + beeper->sample_rate;
+    beeper->sample_remainder = total % WINDOW_HERTZ;
+    return total / WINDOW_HERTZ;
+}
+
+static int32_t adjust_samples(const beeper_object *beeper, uint32_t fill, uint32_t samples)
+{
+    const int32_t error = (int32_t)beeper->target_fill - (int32_t)fill;
+    int32_t limit = (int32_t)samples / AUDIO_DRIFT_DIVISOR;
+
+    if (error > (int32_t)samples || error < -(int32_t)samples) {
+        limit = (int32_t)samples;
+    }
+
+    const int32_t adjust = error / 8;
+    return adjust > limit ? limit : adjust < -limit ? -limit : adjust;
+}
+
+static int16_t next_sample(beeper_object *beeper, bool sounding)
+{
+    const int32_t target = sounding ? VOLUME : 0;
+    const int32_t step = VOLUME / AUDIO_RAMP_SAMPLES;
+
+    if (beeper->level < target) {
+        beeper->level = beeper->level + step > target ? target : beeper->level + step;
+    } else if (beeper->level > target) {
+        beeper->level = beeper->level - step < target ? target : beeper->level - step;
+    }
+
+    beeper->phase += 2 * SOUND_WAVE_FREQUENCY;
+
+    if (beeper->phase >= beeper->sample_rate) {
+        beeper->phase -= beeper->sample_rate;
+        beeper->high = !beeper->high;
+    }
+
+    return (int16_t)(beeper->high ? beeper->level : -beeper->level);
+}
+
+void init_beeper(beeper_object *beeper, audio_ring_object *ring, uint32_t sample_rate, uint32_t device_samples)
+{
+    *beeper = (beeper_object){
+        .sample_rate = sample_rate,
+        .target_fill = device_samples + sample_rate / WINDOW_HERTZ / 2,
+    };
+
+    const int16_t silence[AUDIO_CHUNK] = {0};
+
+    for (uint32_t written = 0; written < beeper->target_fill; written += AUDIO_CHUNK) {
+        const uint32_t count = beeper->target_fill - written;
+        push_audio(ring, silence, count < AUDIO_CHUNK ? count : AUDIO_CHUNK);
+    }
+}
+
+uint32_t generate_audio(beeper_object *beeper, audio_ring_object *ring, bool sounding)
+{
+    const uint32_t samples = frame_samples(beeper);
+    const int32_t count = (int32_t)samples + adjust_samples(beeper, audio_ring_fill(ring), samples);
+    int16_t chunk[AUDIO_CHUNK];
+    uint32_t written = 0;
+
+    while (written < (uint32_t)count) {
+        uint32_t length = (uint32_t)count - written;
+        length = length < AUDIO_CHUNK ? length : AUDIO_CHUNK;
+
+        for (uint32_t index = 0; index < length; index++) {
+            chunk[index] = next_sample(beeper, sounding);
+        }
+
+        const uint32_t pushed = push_audio(ring, chunk, length);
+        written += pushed;
+
+        if (pushed < length) {
+            break;
+        }
+    }
+
+    return written;
+}
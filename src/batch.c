@@ -0,0 +1,432 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "engine.h"
+#include "input_script.h"
+#include "rom_library.h"
+
+#define PATH_LENGTH 512
+
+typedef struct {
+    char rom_name[PATH_LENGTH];
+    char script_name[PATH_LENGTH];
+    const rom_entry_object *rom;
+    uint32_t frames;
+    bool succeeded;
+    uint64_t cycles;
+    uint64_t frame_hash;
+    double wall_ms;
+} job_object;
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} job_queue_object;
+
+typedef struct {
+    job_object *jobs;
+    size_t job_count;
+    job_queue_object *queues;
+    uint32_t worker_count;
+    engine_type engine_kind;
+    uint32_t seed;
+    uint32_t instructions_per_second;
+    bool rate_given;
+    quirk_profile quirks;
+    bool quirks_given;
+    rom_library_object library;
+} batch_object;
+
+typedef struct {
+    batch_object *batch;
+    uint32_t id;
+    pthread_t thread;
+    bool started;
+} worker_object;
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1000.0 + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static bool load_jobs(batch_object *batch, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Job list %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    size_t capacity = 0;
+    char line[PATH_LENGTH * 2 + 32];
+    uint32_t line_number = 0;
+
+    while (fgets(line, sizeof line, file)) {
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        char rom_name[PATH_LENGTH] = {0};
+        char script_name[PATH_LENGTH] = {0};
+        unsigned long frames = 0;
+        const int fields = sscanf(line, "%511s %lu %511s", rom_name, &frames, script_name);
+
+        if (fields <= 0) {
+            continue;
+        }
+
+        if (fields < 2) {
+            fprintf(stderr, "Invalid job line %u in %s\n", line_number, path);
+            fclose(file);
+            return false;
+        }
+
+        if (batch->job_count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            job_object *jobs = realloc(batch->jobs, capacity * sizeof *jobs);
+
+            if (!jobs) {
+                fprintf(stderr, "Could not allocate job list\n");
+                fclose(file);
+                return false;
+            }
+
+            batch->jobs = jobs;
+        }
+
+        job_object *job = &batch->jobs[batch->job_count++];
+        *job = (job_object){.frames = (uint32_t)frames};
+        memcpy(job->rom_name, rom_name, sizeof job->rom_name);
+        memcpy(job->script_name, script_name, sizeof job->script_name);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static void run_job(const batch_object *batch, engine_object *engine, job_object *job)
+{
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    instruction_rate_object rate = {.instructions_per_second = batch->instructions_per_second};
+    chip8_object chip8 = {0};
+    input_script_object script = {0};
+
+    if (job->rom && !batch->rate_given && job->rom->metadata.instructions_per_second > 0) {
+        rate.instructions_per_second = job->rom->metadata.instructions_per_second;
+    }
+
+    job->succeeded = job->rom
+        ? load_chip8(&chip8, job->rom->data, job->rom->size, job->rom->name)
+        : init_chip8(&chip8, job->rom_name);
+
+    chip8.quirks = batch->quirks;
+
+    if (job->succeeded && job->rom && !batch->quirks_given && job->rom->metadata.quirks[0]
+        && !parse_quirk_profile(job->rom->metadata.quirks, &chip8.quirks)) {
+        fprintf(stderr, "Rom %s has unknown quirk profile %s\n", job->rom->name, job->rom->metadata.quirks);
+        job->succeeded = false;
+    }
+
+    if (job->succeeded && job->script_name[0]) {
+        job->succeeded = load_input_script(&script, job->script_name);
+    }
+
+    if (job->succeeded) {
+        seed_chip8(&chip8, batch->seed);
+        reset_engine(engine);
+
+        size_t cursor = 0;
+
+        for (uint32_t frame = 0; frame < job->frames; frame++) {
+            cursor = apply_input_script(&script, cursor, frame, chip8.keypad);
+            const uint32_t instructions_per_frame = frame_instructions(&rate);
+
+            run_engine(engine, &chip8, instructions_per_frame);
+            tick_timers(&chip8);
+            job->cycles += instructions_per_frame;
+        }
+
+        job->frame_hash = hash_display(&chip8);
+    }
+
+    free_input_script(&script);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    job->wall_ms = elapsed_ms(&start, &end);
+}
+
+static bool resolve_jobs(batch_object *batch, const char *path)
+{
+    if (!open_rom_library(&batch->library, path)) {
+        return false;
+    }
+
+    for (size_t index = 0; index < batch->job_count; index++) {
+        job_object *job = &batch->jobs[index];
+        job->rom = find_rom(&batch->library, job->rom_name);
+
+        if (!job->rom) {
+            fprintf(stderr, "Rom %s is not in library %s\n", job->rom_name, path);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool pop_job(job_queue_object *queue, size_t *job_index)
+{
+    pthread_mutex_lock(&queue->lock);
+    const bool found = queue->head < queue->tail;
+
+    if (found) {
+        *job_index = queue->head++;
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static bool steal_job(job_queue_object *queue, size_t *job_index)
+{
+    pthread_mutex_lock(&queue->lock);
+    const bool found = queue->head < queue->tail;
+
+    if (found) {
+        *job_index = --queue->tail;
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static bool next_job(batch_object *batch, uint32_t id, size_t *job_index)
+{
+    if (pop_job(&batch->queues[id], job_index)) {
+        return true;
+    }
+
+    for (uint32_t offset = 1; offset < batch->worker_count; offset++) {
+        if (steal_job(&batch->queues[(id + offset) % batch->worker_count], job_index)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void *worker_main(void *argument)
+{
+    worker_object *worker = argument;
+    batch_object *batch = worker->batch;
+    engine_object *engine = malloc(sizeof *engine);
+
+    if (!engine || !init_engine(engine, batch->engine_kind)) {
+        free(engine);
+        return NULL;
+    }
+
+    size_t job_index = 0;
+
+    while (next_job(batch, worker->id, &job_index)) {
+        run_job(batch, engine, &batch->jobs[job_index]);
+    }
+
+    destroy_engine(engine);
+    free(engine);
+    return NULL;
+}
+
+static void print_json_string(const char *text)
+{
+    putchar('"');
+
+    for (const char *character = text; *character; character++) {
+        if (*character == '"' || *character == '\\') {
+            printf("\\%c", *character);
+            continue;
+        }
+
+        if ((unsigned char)*character < 0x20) {
+            printf("\\u%04x", (unsigned char)*character);
+            continue;
+        }
+
+        putchar(*character);
+    }
+
+    putchar('"');
+}
+
+static void print_job(size_t index, const job_object *job)
+{
+    printf("{\"job\":%zu,\"rom\":", index);
+    print_json_string(job->rom_name);
+    printf(",\"script\":");
+    print_json_string(job->script_name);
+    printf(",\"ok\":%s,\"frames\":%u,\"cycles\":%llu,\"frame_hash\":\"%016llx\",\"wall_ms\":%.3f}\n",
+        job->succeeded ? "true" : "false",
+        job->frames,
+        (unsigned long long)job->cycles,
+        (unsigned long long)job->frame_hash,
+        job->wall_ms);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: %s <jobs> [--threads N] [--seed N] [--ips N] [--engine switch|threaded|jit]\n"
+               "       [--quirks vip|chip48|schip|xochip] [--library PATH]\n", argv[0]);
+        printf("Each job line is: <rom> <frames> [input script]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    batch_object batch = {
+        .engine_kind = ENGINE_SWITCH,
+        .seed = 1,
+        .instructions_per_second = INSTRUCTIONS_PER_SECOND,
+        .quirks = QUIRKS_VIP,
+    };
+
+    const char *library_path = NULL;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    batch.worker_count = cores > 0 ? (uint32_t)cores : 1;
+
+    for (int index = 2; index < argc; index++) {
+        if (strcmp(argv[index], "--threads") == 0 && index + 1 < argc) {
+            uint64_t threads = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &threads)) {
+                printf("Invalid thread count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            batch.worker_count = (uint32_t)threads;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--seed") == 0 && index + 1 < argc) {
+            uint64_t seed = 0;
+
+            if (!parse_count(argv[++index], 0, UINT32_MAX, &seed)) {
+                printf("Invalid seed %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            batch.seed = (uint32_t)seed;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--ips") == 0 && index + 1 < argc) {
+            uint64_t rate = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &rate)) {
+                printf("Invalid instruction rate %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            batch.instructions_per_second = (uint32_t)rate;
+            batch.rate_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--library") == 0 && index + 1 < argc) {
+            library_path = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--quirks") == 0 && index + 1 < argc) {
+            if (!parse_quirk_profile(argv[++index], &batch.quirks)) {
+                printf("Unknown quirk profile %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            batch.quirks_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--engine") == 0 && index + 1 < argc) {
+            if (!parse_engine_type(argv[++index], &batch.engine_kind)) {
+                printf("Unknown engine %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        printf("Unknown option %s\n", argv[index]);
+        exit(EXIT_FAILURE);
+    }
+
+    if (!load_jobs(&batch, argv[1]) || (library_path && !resolve_jobs(&batch, library_path))) {
+        close_rom_library(&batch.library);
+        free(batch.jobs);
+        exit(EXIT_FAILURE);
+    }
+
+    batch.queues = calloc(batch.worker_count, sizeof *batch.queues);
+    worker_object *workers = calloc(batch.worker_count, sizeof *workers);
+
+    if (!batch.queues || !workers) {
+        fprintf(stderr, "Could not allocate worker pool\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t id = 0; id < batch.worker_count; id++) {
+        pthread_mutex_init(&batch.queues[id].lock, NULL);
+        batch.queues[id].head = batch.job_count * id / batch.worker_count;
+        batch.queues[id].tail = batch.job_count * (id + 1) / batch.worker_count;
+    }
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t id = 0; id < batch.worker_count; id++) {
+        workers[id] = (worker_object){.batch = &batch, .id = id};
+        workers[id].started = pthread_create(&workers[id].thread, NULL, worker_main, &workers[id]) == 0;
+
+        if (!workers[id].started) {
+            fprintf(stderr, "Could not start worker %u, running its jobs inline\n", id);
+        }
+    }
+
+    for (uint32_t id = 0; id < batch.worker_count; id++) {
+        if (workers[id].started) {
+            pthread_join(workers[id].thread, NULL);
+        } else {
+            worker_main(&workers[id]);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    bool all_succeeded = true;
+
+    for (size_t index = 0; index < batch.job_count; index++) {
+        print_job(index, &batch.jobs[index]);
+        all_succeeded &= batch.jobs[index].succeeded;
+    }
+
+    fprintf(stderr, "%zu jobs on %u threads in %.3f ms\n", batch.job_count, batch.worker_count, elapsed_ms(&start, &end));
+
+    for (uint32_t id = 0; id < batch.worker_count; id++) {
+        pthread_mutex_destroy(&batch.queues[id].lock);
+    }
+
+    free(workers);
+    free(batch.queues);
+    free(batch.jobs);
+    close_rom_library(&batch.library);
+
+    exit(all_succeeded ? EXIT_SUCCESS : EXIT_FAILURE);
+}
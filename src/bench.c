@@ -0,0 +1,794 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "chip8.h"
+#include "instance_pool.h"
+#include "lockstep.h"
+
+#define LOOP_LENGTH 64
+#define SUBROUTINE 0x400
+#define DATA 0x500
+#define JUMP_NEXT 0x1FFF
+#define JUMP_V0_NEXT 0xBFFF
+#define MAX_PROGRAM 32
+#define ITEM_RESULTS 4
+#define MAX_ROMS 32
+#define NAME_LENGTH 128
+
+typedef struct {
+    const char *name;
+    uint16_t setup[8];
+    uint16_t body[8];
+} opcode_class_object;
+
+typedef struct {
+    const char *name;
+    uint16_t program[MAX_PROGRAM];
+} kernel_object;
+
+typedef struct {
+    char name[NAME_LENGTH];
+    const char *kind;
+    uint64_t instructions;
+    double seconds;
+    bool counters_valid;
+    uint64_t cache_misses;
+    uint64_t branch_misses;
+} bench_result_object;
+
+typedef struct {
+    int cache_misses;
+    int branch_misses;
+} counters_object;
+
+static const opcode_class_object opcode_classes[] = {
+    {"cls", {0}, {0x00E0}},
+    {"call_ret", {0}, {0x2000 | SUBROUTINE}},
+    {"jump", {0}, {JUMP_NEXT}},
+    {"skip", {0x6005}, {0x3001, 0x4005, 0x5010, 0x9000}},
+    {"load_add", {0}, {0x6A12, 0x7A01}},
+    {"alu", {0x6105, 0x6203}, {0x8014, 0x8125, 0x8236, 0x8017, 0x810E, 0x8016, 0x8231, 0x8122}},
+    {"index", {0}, {0xA000 | DATA, 0xF01E}},
+    {"jump_v0", {0x6000}, {JUMP_V0_NEXT}},
+    {"random", {0}, {0xC0FF}},
+    {"draw", {0x6005, 0x6103, 0xA000 | DATA}, {0xD01F}},
+    {"key_skip", {0}, {0xE09E}},
+    {"timer", {0}, {0xF015, 0xF007, 0xF018}},
+    {"font", {0x6007}, {0xF029}},
+    {"bcd", {0x60FE, 0xA000 | DATA}, {0xF033}},
+    {"store", {0xA000 | DATA}, {0xA000 | DATA, 0xF755}},
+    {"load", {0xA000 | DATA}, {0xA000 | DATA, 0xF765}},
+};
+
+static const kernel_object kernels[] = {
+    {"alu_loop", {
+        0x6000, 0x6101, 0x6202, 0x6303,
+        0x8014, 0x8125, 0x8236, 0x8307, 0x810E, 0x8016, 0x8233, 0x8121, 0x7001, 0x1208,
+    }},
+    {"sprite_storm", {
+        0xA20A, 0xC03F, 0xC11F, 0xD01F, 0x1202,
+        0xFF81, 0xBDA5, 0xA5BD, 0x81FF, 0x183C, 0x7EFF, 0x7E3C, 0x1800,
+    }},
+    {"memory_copy", {
+        0xA000 | DATA, 0xFF55, 0xA000 | (DATA + 0x100), 0xFF65, 0x7001, 0x1200,
+    }},
+    {"call_chain", {
+        0x2206, 0x1200, 0x0000, 0x220C, 0x00EE, 0x0000, 0x2212, 0x00EE, 0x0000, 0x7001, 0x00EE,
+    }},
+};
+
+static void reset_machine(chip8_object *chip8)
+{
+    *chip8 = (chip8_object){
+        .state = RUNNING,
+        .program_counter = ENTRYPOINT,
+        .planes = 1,
+    };
+    chip8->stack_pointer = &chip8->stack[0];
+    seed_chip8(chip8, 1);
+}
+
+static void store_opcode(chip8_object *chip8, uint16_t address, uint16_t opcode)
+{
+    chip8->ram[address] = opcode >> 8;
+    chip8->ram[address + 1] = opcode & 0xFF;
+}
+
+static void load_opcode_class(chip8_object *chip8, const opcode_class_object *opcode_class)
+{
+    uint16_t address = ENTRYPOINT;
+    uint8_t setup_length = 0;
+    uint8_t body_length = 0;
+
+    reset_machine(chip8);
+
+    while (setup_length < 8 && opcode_class->setup[setup_length]) {
+        store_opcode(chip8, address, opcode_class->setup[setup_length++]);
+        address += 2;
+    }
+
+    while (body_length < 8 && opcode_class->body[body_length]) {
+        body_length++;
+    }
+
+    const uint16_t loop_start = address;
+
+    for (uint32_t index = 0; index < LOOP_LENGTH; index++) {
+        uint16_t opcode = opcode_class->body[index % body_length];
+
+        if (opcode == JUMP_NEXT || opcode == JUMP_V0_NEXT) {
+            opcode = (opcode & 0xF000) | (address + 2);
+        }
+
+        store_opcode(chip8, address, opcode);
+        address += 2;
+    }
+
+    store_opcode(chip8, address, 0x1000 | loop_start);
+    store_opcode(chip8, SUBROUTINE, 0x00EE);
+    memset(&chip8->ram[DATA], 0xA5, 16);
+}
+
+static void load_kernel(chip8_object *chip8, const kernel_object *kernel)
+{
+    reset_machine(chip8);
+
+    for (uint32_t index = 0; index < MAX_PROGRAM; index++) {
+        store_opcode(chip8, ENTRYPOINT + index * 2, kernel->program[index]);
+    }
+}
+
+#if defined(__linux__)
+
+static int open_counter(uint64_t config)
+{
+    struct perf_event_attr attributes = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof attributes,
+        .config = config,
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+
+    return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+static void open_counters(counters_object *counters)
+{
+    counters->cache_misses = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+    counters->branch_misses = open_counter(PERF_COUNT_HW_BRANCH_MISSES);
+}
+
+static void close_counters(counters_object *counters)
+{
+    if (counters->cache_misses >= 0) {
+        close(counters->cache_misses);
+    }
+
+    if (counters->branch_misses >= 0) {
+        close(counters->branch_misses);
+    }
+}
+
+static void start_counters(const counters_object *counters)
+{
+    if (counters->cache_misses >= 0 && counters->branch_misses >= 0) {
+        ioctl(counters->cache_misses, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->branch_misses, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counters->cache_misses, PERF_EVENT_IOC_ENABLE, 0);
+        ioctl(counters->branch_misses, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static bool stop_counters(const counters_object *counters, bench_result_object *result)
+{
+    if (counters->cache_misses < 0 || counters->branch_misses < 0) {
+        return false;
+    }
+
+    ioctl(counters->cache_misses, PERF_EVENT_IOC_DISABLE, 0);
+    ioctl(counters->branch_misses, PERF_EVENT_IOC_DISABLE, 0);
+
+    return read(counters->cache_misses, &result->cache_misses, sizeof result->cache_misses) == sizeof result->cache_misses
+        && read(counters->branch_misses, &result->branch_misses, sizeof result->branch_misses) == sizeof result->branch_misses;
+}
+
+#else
+
+static void open_counters(counters_object *counters)
+{
+    counters->cache_misses = -1;
+    counters->branch_misses = -1;
+}
+
+static void close_counters(counters_object *counters)
+{
+    (void)counters;
+}
+
+static void start_counters(const counters_object *counters)
+{
+    (void)counters;
+}
+
+static bool stop_counters(const counters_object *counters, bench_result_object *result)
+{
+    (void)counters;
+    (void)result;
+    return false;
+}
+
+#endif
+
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void run_workload(const chip8_object *initial, uint64_t instructions, uint32_t repeats,
+    const counters_object *counters, bench_result_object *result)
+{
+    result->seconds = 0;
+    result->instructions = 0;
+
+    for (uint32_t repeat = 0; repeat < repeats; repeat++) {
+        chip8_object chip8 = *initial;
+        chip8.stack_pointer = chip8.stack + (initial->stack_pointer - initial->stack);
+
+        instruction_rate_object rate = {.instructions_per_second = INSTRUCTIONS_PER_SECOND};
+        bench_result_object sample = {0};
+        uint64_t executed = 0;
+        struct timespec start;
+        struct timespec end;
+
+        start_counters(counters);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while (executed < instructions) {
+            const uint32_t instructions_per_frame = frame_instructions(&rate);
+
+            for (uint32_t index = 0; index < instructions_per_frame; index++) {
+                emulate_instruction(&chip8);
+            }
+
+            tick_timers(&chip8);
+            executed += instructions_per_frame;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        sample.counters_valid = stop_counters(counters, &sample);
+
+        const double seconds = elapsed_seconds(&start, &end);
+
+        if (repeat == 0 || seconds < result->seconds) {
+            result->seconds = seconds;
+            result->instructions = executed;
+            result->counters_valid = sample.counters_valid;
+            result->cache_misses = sample.cache_misses;
+            result->branch_misses = sample.branch_misses;
+        }
+    }
+}
+
+static double ns_per_instruction(const bench_result_object *result)
+{
+    return result->seconds * 1e9 / (double)result->instructions;
+}
+
+static bool load_baseline(const char *path, const char *name, double *baseline)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    char line[512];
+    char key[NAME_LENGTH + 16];
+    bool found = false;
+
+    snprintf(key, sizeof key, "\"name\":\"%s\"", name);
+
+    while (!found && fgets(line, sizeof line, file)) {
+        const char *value = strstr(line, "\"ns_per_instruction\":");
+
+        if (strstr(line, key) && value) {
+            found = sscanf(value + strlen("\"ns_per_instruction\":"), "%lf", baseline) == 1;
+        }
+    }
+
+    fclose(file);
+    return found;
+}
+
+static void print_result(const bench_result_object *result, const char *baseline_path)
+{
+    double baseline = 0;
+
+    fprintf(stderr, "%-8s %-24s %10.2f Minstr/s %8.3f ns/instr",
+        result->kind,
+        result->name,
+        (double)result->instructions / result->seconds / 1e6,
+        ns_per_instruction(result));
+
+    if (result->counters_valid) {
+        fprintf(stderr, " %10llu cache-misses %10llu branch-misses",
+            (unsigned long long)result->cache_misses,
+            (unsigned long long)result->branch_misses);
+    }
+
+    if (baseline_path && load_baseline(baseline_path, result->name, &baseline)) {
+        fprintf(stderr, " %+7.1f%%", (ns_per_instruction(result) / baseline - 1.0) * 100.0);
+    }
+
+    fputc('\n', stderr);
+}
+
+static void keep_best(bench_result_object *result, uint32_t repeat, double seconds, uint64_t executed)
+{
+    if (repeat == 0 || seconds < result->seconds) {
+        result->seconds = seconds;
+        result->instructions = executed;
+        result->counters_valid = false;
+    }
+}
+
+static void bench_separate(const chip8_object *initial, uint32_t count, uint64_t instructions, uint32_t repeats,
+    bench_result_object *result, chip8_object *instances)
+{
+    const interpreter_function interpret = select_interpreter(initial->quirks);
+
+    for (uint32_t repeat = 0; repeat < repeats; repeat++) {
+        for (uint32_t lane = 0; lane < count; lane++) {
+            instances[lane] = *initial;
+            instances[lane].stack_pointer = instances[lane].stack + (initial->stack_pointer - initial->stack);
+            seed_chip8(&instances[lane], lane + 1);
+        }
+
+        instruction_rate_object rate = {.instructions_per_second = INSTRUCTIONS_PER_SECOND};
+        uint64_t executed = 0;
+        struct timespec start;
+        struct timespec end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while (executed < instructions) {
+            const uint32_t instructions_per_frame = frame_instructions(&rate);
+
+            for (uint32_t lane = 0; lane < count; lane++) {
+                for (uint32_t index = 0; index < instructions_per_frame; index++) {
+                    interpret(&instances[lane]);
+                }
+
+                tick_timers(&instances[lane]);
+            }
+
+            executed += (uint64_t)instructions_per_frame * count;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        keep_best(result, repeat, elapsed_seconds(&start, &end), executed);
+    }
+}
+
+static bool bench_lockstep(const chip8_object *initial, uint32_t count, uint64_t instructions, uint32_t repeats,
+    bench_result_object *result, const chip8_object *expected, double *vectorized)
+{
+    lockstep_object *lockstep = aligned_alloc(_Alignof(lockstep_object), sizeof *lockstep);
+    bool matches = true;
+
+    if (!lockstep) {
+        fprintf(stderr, "Could not allocate lockstep group\n");
+        return false;
+    }
+
+    for (uint32_t repeat = 0; repeat < repeats; repeat++) {
+        if (!init_lockstep(lockstep, initial, count)) {
+            free(lockstep);
+            return false;
+        }
+
+        for (uint32_t lane = 0; lane < count; lane++) {
+            seed_chip8(&lockstep->instances[lane], lane + 1);
+        }
+
+        instruction_rate_object rate = {.instructions_per_second = INSTRUCTIONS_PER_SECOND};
+        uint64_t executed = 0;
+        struct timespec start;
+        struct timespec end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while (executed < instructions) {
+            const uint32_t instructions_per_frame = frame_instructions(&rate);
+
+            run_lockstep(lockstep, instructions_per_frame);
+            tick_lockstep_timers(lockstep);
+            executed += (uint64_t)instructions_per_frame * count;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        keep_best(result, repeat, elapsed_seconds(&start, &end), executed);
+        *vectorized = (double)lockstep->vector_steps / (double)(lockstep->vector_steps + lockstep->scalar_steps);
+
+        for (uint32_t lane = 0; repeat == 0 && lane < count; lane++) {
+            if (!compare_chip8(sync_lockstep_instance(lockstep, lane), &expected[lane])) {
+                fprintf(stderr, "Lockstep instance %u diverged from its separate run on %s\n", lane, result->name);
+                matches = false;
+            }
+        }
+
+        destroy_lockstep(lockstep);
+    }
+
+    free(lockstep);
+    return matches;
+}
+
+static bool compare_lockstep(const chip8_object *initial, const char *name, uint32_t count, uint64_t instructions,
+    uint32_t repeats, const char *baseline, bench_result_object *results, size_t *result_count)
+{
+    chip8_object *instances = malloc(count * sizeof *instances);
+    bench_result_object *separate = &results[(*result_count)++];
+    bench_result_object *lockstep = &results[(*result_count)++];
+    double vectorized = 0;
+
+    if (!instances) {
+        fprintf(stderr, "Could not allocate %u instances\n", count);
+        return false;
+    }
+
+    snprintf(separate->name, sizeof separate->name, "%s x%u", name, count);
+    snprintf(lockstep->name, sizeof lockstep->name, "%s x%u", name, count);
+    separate->kind = "separate";
+    lockstep->kind = "lockstep";
+
+    bench_separate(initial, count, instructions, repeats, separate, instances);
+    print_result(separate, baseline);
+
+    const bool matches = bench_lockstep(initial, count, instructions, repeats, lockstep, instances, &vectorized);
+    print_result(lockstep, baseline);
+    fprintf(stderr, "%-8s %-24s %10.2fx speedup %7.1f%% vectorized\n",
+        "", lockstep->name, separate->seconds / lockstep->seconds, vectorized * 100.0);
+
+    free(instances);
+    return matches;
+}
+
+static void run_pool_frame(instance_pool_object *pool, chip8_object *worker, interpreter_function interpret,
+    uint32_t instructions_per_frame, bool *allocated)
+{
+    for (uint32_t index = 0; index < pool->count; index++) {
+        checkout_instance(pool, index, worker);
+
+        for (uint32_t step = 0; step < instructions_per_frame; step++) {
+            interpret(worker);
+        }
+
+        tick_timers(worker);
+        *allocated &= checkin_instance(pool, index, worker);
+    }
+}
+
+static bool bench_pool(const chip8_object *initial, const char *name, uint32_t count, uint64_t instructions,
+    uint32_t repeats, const char *baseline, bench_result_object *result)
+{
+    const interpreter_function interpret = select_interpreter(initial->quirks);
+    chip8_object *worker = malloc(sizeof *worker);
+    chip8_object *expected = malloc(sizeof *expected);
+    instance_pool_object *pool = malloc(sizeof *pool);
+    bool matches = true;
+    size_t bytes = 0;
+
+    if (!worker || !expected || !pool) {
+        fprintf(stderr, "Could not allocate instance pool\n");
+        free(worker);
+        free(expected);
+        free(pool);
+        return false;
+    }
+
+    snprintf(result->name, sizeof result->name, "%s x%u", name, count);
+    result->kind = "pool";
+
+    for (uint32_t repeat = 0; repeat < repeats && matches; repeat++) {
+        if (!init_instance_pool(pool, initial, count)) {
+            matches = false;
+            break;
+        }
+
+        init_pool_worker(pool, worker);
+
+        for (uint32_t index = 0; index < count; index++) {
+            checkout_instance(pool, index, worker);
+            seed_chip8(worker, index + 1);
+            matches &= checkin_instance(pool, index, worker);
+        }
+
+        instruction_rate_object rate = {.instructions_per_second = INSTRUCTIONS_PER_SECOND};
+        uint64_t executed = 0;
+        uint32_t frames = 0;
+        struct timespec start;
+        struct timespec end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        while (executed < instructions && matches) {
+            const uint32_t instructions_per_frame = frame_instructions(&rate);
+
+            run_pool_frame(pool, worker, interpret, instructions_per_frame, &matches);
+            executed += (uint64_t)instructions_per_frame * count;
+            frames++;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        keep_best(result, repeat, elapsed_seconds(&start, &end), executed);
+        bytes = instance_pool_memory(pool);
+
+        for (uint32_t index = 0; repeat == 0 && index < count; index += count > 64 ? count / 64 : 1) {
+            *expected = *initial;
+            expected->stack_pointer = expected->stack + (initial->stack_pointer - initial->stack);
+            seed_chip8(expected, index + 1);
+            rate = (instruction_rate_object){.instructions_per_second = INSTRUCTIONS_PER_SECOND};
+
+            for (uint32_t frame = 0; frame < frames; frame++) {
+                const uint32_t instructions_per_frame = frame_instructions(&rate);
+
+                for (uint32_t step = 0; step < instructions_per_frame; step++) {
+                    interpret(expected);
+                }
+
+                tick_timers(expected);
+            }
+
+            checkout_instance(pool, index, worker);
+
+            if (!compare_chip8(worker, expected)) {
+                fprintf(stderr, "Pooled instance %u diverged from its separate run on %s\n", index, name);
+                matches = false;
+            }
+        }
+
+        destroy_instance_pool(pool);
+    }
+
+    print_result(result, baseline);
+    fprintf(stderr, "%-8s %-24s %10.0f bytes/instance %7zu bytes as chip8_object\n",
+        "", result->name, (double)bytes / count, sizeof *worker);
+    free(worker);
+    free(expected);
+    free(pool);
+    return matches;
+}
+
+static void print_json_string(FILE *file, const char *text)
+{
+    fputc('"', file);
+
+    for (const char *character = text; *character; character++) {
+        if (*character == '"' || *character == '\\') {
+            fprintf(file, "\\%c", *character);
+            continue;
+        }
+
+        if ((unsigned char)*character < 0x20) {
+            fprintf(file, "\\u%04x", (unsigned char)*character);
+            continue;
+        }
+
+        fputc(*character, file);
+    }
+
+    fputc('"', file);
+}
+
+static bool save_results(const char *path, const bench_result_object *results, size_t count, uint32_t repeats)
+{
+    FILE *file = path ? fopen(path, "w") : stdout;
+    if (!file) {
+        fprintf(stderr, "Could not open benchmark output %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"repeats\":%u,\"results\":[\n", repeats);
+
+    for (size_t index = 0; index < count; index++) {
+        const bench_result_object *result = &results[index];
+
+        fprintf(file, "{\"name\":");
+        print_json_string(file, result->name);
+        fprintf(file, ",\"kind\":\"%s\",\"instructions\":%llu,\"seconds\":%.6f,\"instructions_per_second\":%.0f,"
+                      "\"ns_per_instruction\":%.4f,",
+            result->kind,
+            (unsigned long long)result->instructions,
+            result->seconds,
+            (double)result->instructions / result->seconds,
+            ns_per_instruction(result));
+
+        if (result->counters_valid) {
+            fprintf(file, "\"cache_misses\":%llu,\"branch_misses\":%llu}",
+                (unsigned long long)result->cache_misses,
+                (unsigned long long)result->branch_misses);
+        } else {
+            fprintf(file, "\"cache_misses\":null,\"branch_misses\":null}");
+        }
+
+        fprintf(file, "%s\n", index + 1 < count ? "," : "");
+    }
+
+    fprintf(file, "]}\n");
+
+    const bool write_success = !ferror(file);
+
+    if (path) {
+        fclose(file);
+    }
+
+    return write_success;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t instructions = 20000000;
+    uint32_t repeats = 3;
+    const char *output = NULL;
+    const char *baseline = NULL;
+    const char *roms[MAX_ROMS];
+    size_t rom_count = 0;
+    uint32_t lockstep_count = 0;
+    uint32_t pool_count = 0;
+    bool instances_match = true;
+
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "--instructions") == 0 && index + 1 < argc) {
+            if (!parse_count(argv[++index], 1, UINT64_MAX, &instructions)) {
+                printf("Invalid instruction count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[index], "--repeats") == 0 && index + 1 < argc) {
+            uint64_t count = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &count)) {
+                printf("Invalid repeat count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            repeats = (uint32_t)count;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--output") == 0 && index + 1 < argc) {
+            output = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--baseline") == 0 && index + 1 < argc) {
+            baseline = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--lockstep") == 0 && index + 1 < argc) {
+            uint64_t count = 0;
+
+            if (!parse_count(argv[++index], 1, LOCKSTEP_MAX_INSTANCES, &count)) {
+                printf("Lockstep instance count must be between 1 and %d\n", LOCKSTEP_MAX_INSTANCES);
+                exit(EXIT_FAILURE);
+            }
+            lockstep_count = (uint32_t)count;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--pool") == 0 && index + 1 < argc) {
+            uint64_t count = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &count)) {
+                printf("Pool instance count must be positive\n");
+                exit(EXIT_FAILURE);
+            }
+            pool_count = (uint32_t)count;
+            continue;
+        }
+
+        if (argv[index][0] == '-') {
+            printf("Usage: %s [--instructions N] [--repeats N] [--lockstep N] [--pool N] [--output FILE] [--baseline FILE] [rom...]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+
+        if (rom_count == MAX_ROMS) {
+            printf("Too many roms\n");
+            exit(EXIT_FAILURE);
+        }
+
+        roms[rom_count++] = argv[index];
+    }
+
+    if (instructions == 0 || repeats == 0) {
+        printf("Instruction and repeat counts must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    static bench_result_object results[sizeof opcode_classes / sizeof opcode_classes[0]
+        + (sizeof kernels / sizeof kernels[0] + MAX_ROMS) * ITEM_RESULTS];
+    size_t result_count = 0;
+    counters_object counters;
+    chip8_object chip8;
+
+    open_counters(&counters);
+
+    for (size_t index = 0; index < sizeof opcode_classes / sizeof opcode_classes[0]; index++) {
+        bench_result_object *result = &results[result_count++];
+
+        snprintf(result->name, sizeof result->name, "%s", opcode_classes[index].name);
+        result->kind = "class";
+        load_opcode_class(&chip8, &opcode_classes[index]);
+        run_workload(&chip8, instructions, repeats, &counters, result);
+        print_result(result, baseline);
+    }
+
+    for (size_t index = 0; index < sizeof kernels / sizeof kernels[0]; index++) {
+        bench_result_object *result = &results[result_count++];
+
+        snprintf(result->name, sizeof result->name, "%s", kernels[index].name);
+        result->kind = "kernel";
+        load_kernel(&chip8, &kernels[index]);
+        run_workload(&chip8, instructions, repeats, &counters, result);
+        print_result(result, baseline);
+
+        if (lockstep_count) {
+            instances_match &= compare_lockstep(&chip8, kernels[index].name, lockstep_count, instructions, repeats,
+                baseline, results, &result_count);
+        }
+
+        if (pool_count) {
+            instances_match &= bench_pool(&chip8, kernels[index].name, pool_count, instructions, repeats, baseline,
+                &results[result_count++]);
+        }
+    }
+
+    for (size_t index = 0; index < rom_count; index++) {
+        chip8 = (chip8_object){0};
+
+        if (!init_chip8(&chip8, roms[index])) {
+            continue;
+        }
+
+        bench_result_object *result = &results[result_count++];
+
+        seed_chip8(&chip8, 1);
+        snprintf(result->name, sizeof result->name, "%s", roms[index]);
+        result->kind = "rom";
+        run_workload(&chip8, instructions, repeats, &counters, result);
+        print_result(result, baseline);
+
+        if (lockstep_count) {
+            instances_match &= compare_lockstep(&chip8, roms[index], lockstep_count, instructions, repeats,
+                baseline, results, &result_count);
+        }
+
+        if (pool_count) {
+            instances_match &= bench_pool(&chip8, roms[index], pool_count, instructions, repeats, baseline,
+                &results[result_count++]);
+        }
+    }
+
+    close_counters(&counters);
+
+    if (!save_results(output, results, result_count, repeats) || !instances_match) {
+        exit(EXIT_FAILURE);
+    }
+
+    exit(EXIT_SUCCESS);
+}
@@ -1,14 +1,30 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-#include "SDL.h"
 #include "chip8.h"
+#include "debugger.h"
+#include "profile.h"
+#include "rom_library.h"
+#include "trace.h"
 
 bool init_chip8(chip8_object *chip8, const char rom_name[])
 {
-    const uint32_t entrypoint = 0x200;
+    rom_mapping_object mapping;
+
+    if (!map_rom_file(&mapping, rom_name)) {
+        return false;
+    }
+
+    const bool loaded = load_chip8(chip8, mapping.address, mapping.size, rom_name);
+    unmap_rom_file(&mapping);
+    return loaded;
+}
+
+bool load_chip8(chip8_object *chip8, const uint8_t *rom, size_t rom_size, const char rom_name[])
+{
     const uint8_t font[] = {
         0xF0, 0x90, 0x90, 0x90, 0xF0,
         0x20, 0x60, 0x20, 0x20, 0x70,
@@ -27,161 +43,446 @@ bool init_chip8(chip8_object *chip8, const char rom_name[])
         0xF0, 0x80, 0xF0, 0x80, 0xF0,
         0xF0, 0x80, 0xF0, 0x80, 0x80
     };
+    const uint8_t big_font[] = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0
+    };
 
-    memcpy(&chip8->ram[0], font, sizeof(font));
-
-    FILE *rom = fopen(rom_name, "rb");
-    if (!rom) {
-        SDL_Log("Rom file %s is invalid or does not exist\n", rom_name);
+    if (rom_size > MAX_ROM_SIZE) {
+        fprintf(stderr, "Rom file %s is too big!\n", rom_name);
         return false;
     }
 
-    fseek(rom, 0L, SEEK_END);
-    const size_t rom_size = ftell(rom);
-    const size_t max_size = sizeof chip8->ram - entrypoint;
-    rewind(rom);
+    memcpy(&chip8->ram[FONT_ADDRESS], font, sizeof(font));
+    memcpy(&chip8->ram[BIG_FONT_ADDRESS], big_font, sizeof(big_font));
+    memcpy(&chip8->ram[ENTRYPOINT], rom, rom_size);
 
-    if (rom_size > max_size) {
-        SDL_Log("Rom file %s is too big!\n", rom_name);
-        fclose(rom);
-        return false;
+    chip8->state = RUNNING;
+    chip8->hires = false;
+    chip8->planes = 1;
+    chip8->quirks = QUIRKS_VIP;
+    chip8->program_counter = ENTRYPOINT;
+    chip8->rom_name = rom_name;
+    chip8->rom_hash = hash_rom(rom, rom_size);
+    chip8->stack_pointer = &chip8->stack[0];
+    seed_chip8(chip8, (uint32_t)time(NULL));
+    return true;
+}
+
+void seed_chip8(chip8_object *chip8, uint32_t seed)
+{
+    seed ^= seed >> 16;
+    seed *= 0x7FEB352D;
+    seed ^= seed >> 15;
+    seed *= 0x846CA68B;
+    seed ^= seed >> 16;
+
+    chip8->rng_state = seed ? seed : 0x9E3779B9;
+}
+
+uint8_t random_byte(chip8_object *chip8)
+{
+    uint32_t state = chip8->rng_state;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    chip8->rng_state = state;
+
+    return (uint8_t)(state >> 24);
+}
+
+void mark_ram_dirty(chip8_object *chip8, uint16_t first, uint16_t last)
+{
+    const uint32_t last_block = last / RAM_BLOCK_SIZE;
+
+    for (uint32_t block = first / RAM_BLOCK_SIZE;; block = (block + 1) % RAM_BLOCKS) {
+        chip8->ram_dirty[block / 64] |= 1ULL << (block % 64);
+
+        if (block == last_block) {
+            break;
+        }
     }
+}
+
+void clear_ram_dirty(chip8_object *chip8)
+{
+    memset(chip8->ram_dirty, 0, sizeof chip8->ram_dirty);
+}
 
-    bool read_success = fread(&chip8->ram[entrypoint], rom_size, 1, rom);
+typedef unsigned __int128 display_row;
 
-    if (!read_success) {
-        SDL_Log("Could not read rom file\n");
-        fclose(rom);
-        return false;
+static inline display_row load_row(const uint64_t words[DISPLAY_WORDS])
+{
+    return ((display_row)words[0] << 64) | words[1];
+}
+
+static inline void store_row(uint64_t words[DISPLAY_WORDS], display_row row)
+{
+    words[0] = (uint64_t)(row >> 64);
+    words[1] = (uint64_t)row;
+}
+
+static inline display_row screen_mask(const chip8_object *chip8)
+{
+    return ~(display_row)0 << (DISPLAY_WIDTH - SCREEN_WIDTH(chip8->hires));
+}
+
+static inline uint64_t screen_rows(const chip8_object *chip8)
+{
+    return chip8->hires ? UINT64_MAX : (1ULL << WINDOW_HEIGHT) - 1;
+}
+
+void clear_display(chip8_object *chip8)
+{
+    const uint32_t height = SCREEN_HEIGHT(chip8->hires);
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane))) {
+            continue;
+        }
+
+        for (uint8_t y = 0; y < height; y++) {
+            chip8->dirty_rows |= (uint64_t)((chip8->display[plane][y][0] | chip8->display[plane][y][1]) != 0) << y;
+        }
+
+        memset(chip8->display[plane], 0, height * sizeof chip8->display[plane][0]);
     }
+}
 
-    fclose(rom);
+static inline __attribute__((always_inline)) uint32_t sprite_bits(const chip8_object *chip8, uint16_t address, bool large)
+{
+    if (large) {
+        return (uint32_t)(chip8->ram[address] << 8) | chip8->ram[(uint16_t)(address + 1)];
+    }
 
-    chip8->state = RUNNING;
-    chip8->program_counter = entrypoint;
-    chip8->rom_name = rom_name;
-    chip8->stack_pointer = &chip8->stack[0];
-    return true;
+    return chip8->ram[address];
 }
 
-void emulate_instruction(chip8_object *chip8)
+static inline __attribute__((always_inline)) void draw_planes(chip8_object *chip8, uint8_t x, uint8_t y, uint8_t height,
+    const bool wrap, const bool hires, const bool large)
 {
-    chip8->instruction.opcode = (chip8->ram[chip8->program_counter] << 8) | chip8->ram[chip8->program_counter + 1];
-    chip8->program_counter += 2;
+    const uint32_t width = SCREEN_WIDTH(hires);
+    const uint32_t screen_height = SCREEN_HEIGHT(hires);
+    const uint32_t rows = large ? 16 : height;
+    const uint32_t sprite_width = large ? 16 : 8;
+    const uint32_t x_coord = x % width;
+    const uint32_t y_coord = y % screen_height;
+    const uint32_t visible = (wrap || rows < screen_height - y_coord) ? rows : screen_height - y_coord;
+    uint16_t address = chip8->I;
+    uint64_t dirty_rows = 0;
+    uint64_t collision = 0;
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane))) {
+            continue;
+        }
+
+        for (uint32_t index = 0; index < visible; index++) {
+            const uint32_t bits = sprite_bits(chip8, (uint16_t)(address + index * (sprite_width / 8)), large);
+            const uint32_t row = wrap ? (y_coord + index) % screen_height : y_coord + index;
+            uint64_t *display_words = chip8->display[plane][row];
+
+            if (hires) {
+                const display_row sprite = (display_row)bits << (DISPLAY_WIDTH - sprite_width);
+                const display_row wrapped = (wrap && x_coord) ? sprite << (DISPLAY_WIDTH - x_coord) : 0;
+                const display_row sprite_row = (sprite >> x_coord) | wrapped;
+                const display_row current = load_row(display_words);
+                const display_row overlap = current & sprite_row;
+
+                collision |= (uint64_t)(overlap >> 64) | (uint64_t)overlap;
+                store_row(display_words, current ^ sprite_row);
+                dirty_rows |= (uint64_t)(sprite_row != 0) << row;
+            } else {
+                const uint64_t sprite = (uint64_t)bits << (64 - sprite_width);
+                const uint64_t wrapped = (wrap && x_coord) ? sprite << (64 - x_coord) : 0;
+                const uint64_t sprite_row = (sprite >> x_coord) | wrapped;
+
+                collision |= display_words[0] & sprite_row;
+                display_words[0] ^= sprite_row;
+                dirty_rows |= (uint64_t)(sprite_row != 0) << row;
+            }
+        }
+
+        address += rows * (sprite_width / 8);
+    }
+
+    chip8->dirty_rows |= dirty_rows;
+    chip8->V[0xF] = collision != 0;
+}
+
+void draw_sprite(chip8_object *chip8, uint8_t x, uint8_t y, uint8_t height)
+{
+    if (height == 0) {
+        draw_planes(chip8, x, y, height, false, chip8->hires, true);
+    } else if (chip8->hires) {
+        draw_planes(chip8, x, y, height, false, true, false);
+    } else {
+        draw_planes(chip8, x, y, height, false, false, false);
+    }
+}
+
+void draw_sprite_wrapped(chip8_object *chip8, uint8_t x, uint8_t y, uint8_t height)
+{
+    if (height == 0) {
+        draw_planes(chip8, x, y, height, true, chip8->hires, true);
+    } else if (chip8->hires) {
+        draw_planes(chip8, x, y, height, true, true, false);
+    } else {
+        draw_planes(chip8, x, y, height, true, false, false);
+    }
+}
+
+void scroll_display_rows(chip8_object *chip8, int32_t rows)
+{
+    const uint32_t height = SCREEN_HEIGHT(chip8->hires);
+    const uint32_t magnitude = rows < 0 ? (uint32_t)-rows : (uint32_t)rows;
+    const uint32_t distance = magnitude < height ? magnitude : height;
+    const size_t row_size = sizeof chip8->display[0][0];
+
+    if (distance == 0) {
+        return;
+    }
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane))) {
+            continue;
+        }
+
+        uint64_t (*display)[DISPLAY_WORDS] = chip8->display[plane];
+
+        if (rows > 0) {
+            memmove(display[distance], display[0], (height - distance) * row_size);
+            memset(display[0], 0, distance * row_size);
+        } else {
+            memmove(display[0], display[distance], (height - distance) * row_size);
+            memset(display[height - distance], 0, distance * row_size);
+        }
+    }
+
+    chip8->dirty_rows |= screen_rows(chip8);
+}
+
+void scroll_display_columns(chip8_object *chip8, int32_t columns)
+{
+    const uint32_t height = SCREEN_HEIGHT(chip8->hires);
+    const display_row mask = screen_mask(chip8);
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane))) {
+            continue;
+        }
+
+        for (uint32_t y = 0; y < height; y++) {
+            const display_row row = load_row(chip8->display[plane][y]);
+            store_row(chip8->display[plane][y], (columns > 0 ? row >> columns : row << -columns) & mask);
+        }
+    }
+
+    chip8->dirty_rows |= screen_rows(chip8);
+}
+
+void set_resolution(chip8_object *chip8, bool hires)
+{
+    chip8->hires = hires;
+    chip8->dirty_rows = UINT64_MAX;
+    memset(chip8->display, 0, sizeof chip8->display);
+}
+
+static inline __attribute__((always_inline)) uint16_t skip_length(const chip8_object *chip8, const uint32_t quirks)
+{
+    if ((quirks & QUIRK_LONG_SKIP)
+        && chip8->ram[chip8->program_counter] == 0xF0 && chip8->ram[(uint16_t)(chip8->program_counter + 1)] == 0x00) {
+        return 4;
+    }
+
+    return 2;
+}
+
+static inline __attribute__((always_inline)) void execute_instruction(chip8_object *chip8, const uint32_t quirks)
+{
+    instruction_object instruction;
+    const uint16_t address = chip8->program_counter;
 
-    chip8->instruction.NNN = chip8->instruction.opcode & 0x0FFF;
-    chip8->instruction.NN = chip8->instruction.opcode & 0x0FF;
-    chip8->instruction.N = chip8->instruction.opcode & 0x0F;
-    chip8->instruction.X = (chip8->instruction.opcode >> 8) & 0x0F;
-    chip8->instruction.Y = (chip8->instruction.opcode >> 4) & 0x0F;
+    PROFILE_INSTRUCTION(chip8, address);
 
-    srand(time(NULL));
+    instruction.opcode = (chip8->ram[chip8->program_counter] << 8) | chip8->ram[(uint16_t)(chip8->program_counter + 1)];
+    chip8->program_counter += 2;
+
+    instruction.NNN = instruction.opcode & 0x0FFF;
+    instruction.NN = instruction.opcode & 0x0FF;
+    instruction.N = instruction.opcode & 0x0F;
+    instruction.X = (instruction.opcode >> 8) & 0x0F;
+    instruction.Y = (instruction.opcode >> 4) & 0x0F;
 
     bool positive_result = false;
+    uint8_t source = 0;
 
-    switch ((chip8->instruction.opcode >> 12) & 0x0F)
+    switch ((instruction.opcode >> 12) & 0x0F)
     {
         case 0x00:
-            if (chip8->instruction.NN == 0xE0) {
-                memset(chip8->display, false, sizeof chip8->display);
-                break;
-            }
+            switch (instruction.NN)
+            {
+                case 0xE0:
+                    clear_display(chip8);
+                    break;
 
-            if (chip8->instruction.NN == 0xEE) {
-                chip8->program_counter = *--chip8->stack_pointer;
-                break;
+                case 0xEE:
+                    chip8->program_counter = *--chip8->stack_pointer;
+                    break;
+
+                case 0xFB:
+                    scroll_display_columns(chip8, 4);
+                    break;
+
+                case 0xFC:
+                    scroll_display_columns(chip8, -4);
+                    break;
+
+                case 0xFD:
+                    chip8->program_counter -= 2;
+                    break;
+
+                case 0xFE:
+                    set_resolution(chip8, false);
+                    break;
+
+                case 0xFF:
+                    set_resolution(chip8, true);
+                    break;
+
+                default:
+                    if ((instruction.NN & 0xF0) == 0xC0) {
+                        scroll_display_rows(chip8, instruction.N);
+                    } else if ((instruction.NN & 0xF0) == 0xD0) {
+                        scroll_display_rows(chip8, -instruction.N);
+                    }
+                    break;
             }
             break;
 
         case 0x01:
-            chip8->program_counter = chip8->instruction.NNN;
+            chip8->program_counter = instruction.NNN;
             break;
 
         case 0x02:
             *chip8->stack_pointer++ = chip8->program_counter;
-            chip8->program_counter = chip8->instruction.NNN;
+            chip8->program_counter = instruction.NNN;
             break;
 
         case 0x03:
-            if (chip8->V[chip8->instruction.X] == chip8->instruction.NN) {
-                chip8->program_counter += 2;
+            if (chip8->V[instruction.X] == instruction.NN) {
+                chip8->program_counter += skip_length(chip8, quirks);
             }
             break;
 
         case 0x04:
-            if (chip8->V[chip8->instruction.X] != chip8->instruction.NN) {
-                chip8->program_counter += 2;
+            if (chip8->V[instruction.X] != instruction.NN) {
+                chip8->program_counter += skip_length(chip8, quirks);
             }
             break;
 
-        case 0x05:
-            if (chip8->instruction.N != 0) {
-                break;
-            }
-            if (chip8->V[chip8->instruction.X] == chip8->V[chip8->instruction.Y]) {
-                chip8->program_counter += 2;
+        case 0x05: {
+            const uint8_t distance = instruction.X < instruction.Y ? instruction.Y - instruction.X : instruction.X - instruction.Y;
+            const int8_t direction = instruction.X < instruction.Y ? 1 : -1;
+
+            if (instruction.N == 0 && chip8->V[instruction.X] == chip8->V[instruction.Y]) {
+                chip8->program_counter += skip_length(chip8, quirks);
+            } else if (instruction.N == 2) {
+                for (uint8_t index = 0; index <= distance; index++) {
+                    chip8->ram[(uint16_t)(chip8->I + index)] = chip8->V[instruction.X + direction * index];
+                }
+
+                mark_ram_dirty(chip8, chip8->I, chip8->I + distance);
+            } else if (instruction.N == 3) {
+                for (uint8_t index = 0; index <= distance; index++) {
+                    chip8->V[instruction.X + direction * index] = chip8->ram[(uint16_t)(chip8->I + index)];
+                }
             }
             break;
+        }
 
         case 0x06:
-            chip8->V[chip8->instruction.X] = chip8->instruction.NN;
+            chip8->V[instruction.X] = instruction.NN;
             break;
 
         case 0x07:
-            chip8->V[chip8->instruction.X] += chip8->instruction.NN;
+            chip8->V[instruction.X] += instruction.NN;
             break;
 
         case 0x08:
-            switch (chip8->instruction.N)
+            switch (instruction.N)
             {
                 case 0:
-                    chip8->V[chip8->instruction.X] = chip8->V[chip8->instruction.Y];
+                    chip8->V[instruction.X] = chip8->V[instruction.Y];
                     break;
 
                 case 1:
-                    chip8->V[chip8->instruction.X] |= chip8->V[chip8->instruction.Y];
-                    chip8->V[0xF] = 0;
+                    chip8->V[instruction.X] |= chip8->V[instruction.Y];
+                    if (quirks & QUIRK_VF_RESET) {
+                        chip8->V[0xF] = 0;
+                    }
                     break;
 
                 case 2:
-                    chip8->V[chip8->instruction.X] &= chip8->V[chip8->instruction.Y];
-                    chip8->V[0xF] = 0;
+                    chip8->V[instruction.X] &= chip8->V[instruction.Y];
+                    if (quirks & QUIRK_VF_RESET) {
+                        chip8->V[0xF] = 0;
+                    }
                     break;
 
                 case 3:
-                    chip8->V[chip8->instruction.X] ^= chip8->V[chip8->instruction.Y];
-                    chip8->V[0xF] = 0;
+                    chip8->V[instruction.X] ^= chip8->V[instruction.Y];
+                    if (quirks & QUIRK_VF_RESET) {
+                        chip8->V[0xF] = 0;
+                    }
                     break;
 
                 case 4: {
                     const bool carry =
-                        ((uint16_t)(chip8->V[chip8->instruction.X] + chip8->V[chip8->instruction.Y]) > 255);
-                    chip8->V[chip8->instruction.X] += chip8->V[chip8->instruction.Y];
+                        ((uint16_t)(chip8->V[instruction.X] + chip8->V[instruction.Y]) > 255);
+                    chip8->V[instruction.X] += chip8->V[instruction.Y];
                     chip8->V[0xF] = carry;
                     break;
                 }
 
                 case 5:
-                    positive_result = (chip8->V[chip8->instruction.Y] <= chip8->V[chip8->instruction.X]);
-                    chip8->V[chip8->instruction.X] -= chip8->V[chip8->instruction.Y];
+                    positive_result = (chip8->V[instruction.Y] <= chip8->V[instruction.X]);
+                    chip8->V[instruction.X] -= chip8->V[instruction.Y];
                     chip8->V[0xF] = positive_result;
                     break;
 
                 case 6:
-                    positive_result = chip8->V[chip8->instruction.Y] & 1;
-                    chip8->V[chip8->instruction.X] = chip8->V[chip8->instruction.Y] >> 1;
+                    source = chip8->V[(quirks & QUIRK_SHIFT_VX) ? instruction.X : instruction.Y];
+                    positive_result = source & 1;
+                    chip8->V[instruction.X] = source >> 1;
                     chip8->V[0xF] = positive_result;
                     break;
 
                 case 7:
-                    positive_result = (chip8->V[chip8->instruction.X] <= chip8->V[chip8->instruction.Y]);
-                    chip8->V[chip8->instruction.X] = chip8->V[chip8->instruction.Y] - chip8->V[chip8->instruction.X];
+                    positive_result = (chip8->V[instruction.X] <= chip8->V[instruction.Y]);
+                    chip8->V[instruction.X] = chip8->V[instruction.Y] - chip8->V[instruction.X];
                     chip8->V[0xF] = positive_result;
                     break;
 
                 case 0xE:
-                    positive_result = (chip8->V[chip8->instruction.Y] & 0x80) >> 7;
-                    chip8->V[chip8->instruction.X] = chip8->V[chip8->instruction.Y] << 1;
+                    source = chip8->V[(quirks & QUIRK_SHIFT_VX) ? instruction.X : instruction.Y];
+                    positive_result = (source & 0x80) >> 7;
+                    chip8->V[instruction.X] = source << 1;
                     chip8->V[0xF] = positive_result;
                     break;
 
@@ -191,149 +492,150 @@ void emulate_instruction(chip8_object *chip8)
             break;
 
         case 0x09:
-            if (chip8->V[chip8->instruction.X] != chip8->V[chip8->instruction.Y]) {
-                chip8->program_counter += 2;
+            if (chip8->V[instruction.X] != chip8->V[instruction.Y]) {
+                chip8->program_counter += skip_length(chip8, quirks);
             }
             break;
 
         case 0x0A:
-            chip8->I = chip8->instruction.NNN;
+            chip8->I = instruction.NNN;
             break;
 
         case 0x0B:
-            chip8->program_counter = chip8->V[0] + chip8->instruction.NNN;
+            chip8->program_counter = chip8->V[(quirks & QUIRK_JUMP_VX) ? instruction.X : 0] + instruction.NNN;
             break;
 
         case 0x0C:
-            chip8->V[chip8->instruction.X] = (rand() % 256) & chip8->instruction.NN;
+            chip8->V[instruction.X] = random_byte(chip8) & instruction.NN;
             break;
 
-        case 0x0D: {
-            uint8_t x_coord = chip8->V[chip8->instruction.X] % WINDOW_WIDTH;
-            uint8_t y_coord = chip8->V[chip8->instruction.Y] % WINDOW_HEIGHT;
-            const uint8_t original_x = x_coord;
-
-            chip8->V[0xF] = 0;
-
-            for (uint8_t index = 0; index < chip8->instruction.N; index++) {
-                const uint8_t sprite_data = chip8->ram[chip8->I + index];
-                x_coord = original_x;
-
-                for (int8_t j = 7; j >= 0; j--) {
-                    bool *pixel = &chip8->display[y_coord * WINDOW_WIDTH + x_coord];
-                    const bool sprite_bit = (sprite_data & (1 << j));
-
-                    if (sprite_bit && *pixel) {
-                        chip8->V[0xF] = 1;
-                    }
-
-                    *pixel ^= sprite_bit;
-
-                    if (++x_coord >= WINDOW_WIDTH) {
-                        break;
-                    }
-                }
-
-                if (++y_coord >= WINDOW_HEIGHT) {
-                    break;
-                }
+        case 0x0D:
+            if (quirks & QUIRK_CLIPPING) {
+                draw_sprite(chip8, chip8->V[instruction.X], chip8->V[instruction.Y], instruction.N);
+            } else {
+                draw_sprite_wrapped(chip8, chip8->V[instruction.X], chip8->V[instruction.Y], instruction.N);
             }
-
             break;
-        }
 
         case 0x0E:
-            if (chip8->instruction.NN == 0x9E) {
-                uint8_t vx = chip8->V[chip8->instruction.X];
+            if (instruction.NN == 0x9E) {
+                uint8_t vx = chip8->V[instruction.X];
                 if (chip8->keypad[vx]) {
-                    chip8->program_counter += 2;
+                    chip8->program_counter += skip_length(chip8, quirks);
                 }
                 break;
             }
-            if (chip8->instruction.NN == 0xA1) {
-                uint8_t vx = chip8->V[chip8->instruction.X];
+            if (instruction.NN == 0xA1) {
+                uint8_t vx = chip8->V[instruction.X];
                 if (!chip8->keypad[vx]) {
-                    chip8->program_counter += 2;
+                    chip8->program_counter += skip_length(chip8, quirks);
                 }
                 break;
             }
             break;
 
         case 0x0F:
-            switch (chip8->instruction.NN)
+            switch (instruction.NN)
             {
-                case 0x07:
-                    chip8->V[chip8->instruction.X] = chip8->delay_timer;
+                case 0x00:
+                    if (instruction.X == 0) {
+                        chip8->I = (chip8->ram[chip8->program_counter] << 8) | chip8->ram[(uint16_t)(chip8->program_counter + 1)];
+                        chip8->program_counter += 2;
+                    }
                     break;
 
-                case 0x0A: {
-                    static bool any_key_pressed = false;
-                    static int8_t key = -1;
+                case 0x01:
+                    chip8->planes = instruction.X & ((1 << DISPLAY_PLANES) - 1);
+                    break;
 
+                case 0x07:
+                    chip8->V[instruction.X] = chip8->delay_timer;
+                    break;
+
+                case 0x0A:
                     for (uint8_t index = 0; index < sizeof chip8->keypad; index++) {
                         if (chip8->keypad[index]) {
-                            key = (int8_t)index;
-                            any_key_pressed = true;
+                            chip8->pending_key = index;
+                            chip8->key_pending = true;
                             break;
                         }
                     }
 
-                    if (!any_key_pressed) {
+                    if (!chip8->key_pending) {
                         chip8->program_counter -= 2;
                         break;
                     }
 
-                    if (chip8->keypad[(uint8_t)key]) {
+                    if (chip8->keypad[chip8->pending_key]) {
                         chip8->program_counter -= 2;
                         break;
                     }
 
-                    chip8->V[chip8->instruction.X] = (uint8_t)key;
-                    key = -1;
-                    any_key_pressed = false;
-
+                    chip8->V[instruction.X] = chip8->pending_key;
+                    chip8->key_pending = false;
                     break;
-                }
 
                 case 0x15:
-                    chip8->delay_timer = chip8->V[chip8->instruction.X];
+                    chip8->delay_timer = chip8->V[instruction.X];
                     break;
 
                 case 0x18:
-                    chip8->sound_timer = chip8->V[chip8->instruction.X];
+                    chip8->sound_timer = chip8->V[instruction.X];
                     break;
 
                 case 0x1E:
-                    chip8->I += chip8->V[chip8->instruction.X];
+                    chip8->I += chip8->V[instruction.X];
                     break;
 
                 case 0x29:
-                    chip8->I = chip8->V[chip8->instruction.X] * 5;
+                    chip8->I = chip8->V[instruction.X] * 5;
+                    break;
+
+                case 0x30:
+                    chip8->I = BIG_FONT_ADDRESS + (chip8->V[instruction.X] & 0x0F) * 10;
                     break;
 
                 case 0x33: {
-                    uint8_t bcd = chip8->V[chip8->instruction.X];
+                    uint8_t bcd = chip8->V[instruction.X];
 
-                    chip8->ram[chip8->I + 2] = bcd % 10;
+                    chip8->ram[(uint16_t)(chip8->I + 2)] = bcd % 10;
                     bcd /= 10;
-                    chip8->ram[chip8->I + 1] = bcd % 10;
+                    chip8->ram[(uint16_t)(chip8->I + 1)] = bcd % 10;
                     bcd /= 10;
                     chip8->ram[chip8->I] = bcd;
+                    mark_ram_dirty(chip8, chip8->I, chip8->I + 2);
                     break;
                 }
 
                 case 0x55:
-                    for (uint8_t index = 0; index <= chip8->instruction.X; index++) {
-                        chip8->ram[chip8->I++] = chip8->V[index];
+                    for (uint8_t index = 0; index <= instruction.X; index++) {
+                        chip8->ram[(uint16_t)(chip8->I + index)] = chip8->V[index];
+                    }
+
+                    mark_ram_dirty(chip8, chip8->I, chip8->I + instruction.X);
+                    if (quirks & QUIRK_MEMORY_INCREMENT) {
+                        chip8->I += instruction.X + 1;
                     }
                     break;
 
                 case 0x65:
-                    for (uint8_t index = 0; index <= chip8->instruction.X; index++) {
-                        chip8->V[index] = chip8->ram[chip8->I++];
+                    for (uint8_t index = 0; index <= instruction.X; index++) {
+                        chip8->V[index] = chip8->ram[(uint16_t)(chip8->I + index)];
+                    }
+
+                    if (quirks & QUIRK_MEMORY_INCREMENT) {
+                        chip8->I += instruction.X + 1;
                     }
                     break;
 
+                case 0x75:
+                    memcpy(chip8->rpl, chip8->V, instruction.X + 1);
+                    break;
+
+                case 0x85:
+                    memcpy(chip8->V, chip8->rpl, instruction.X + 1);
+                    break;
+
                 default:
                     break;
             }
@@ -342,4 +644,385 @@ void emulate_instruction(chip8_object *chip8)
         default:
             break;
     }
+
+    TRACE_INSTRUCTION(chip8, address, &instruction);
+}
+
+#define DEFINE_INTERPRETER(profile, name, flags)      \
+    static void emulate_##name(chip8_object *chip8)    \
+    {                                                  \
+        execute_instruction(chip8, flags);             \
+    }
+
+QUIRK_PROFILES(DEFINE_INTERPRETER)
+
+static inline __attribute__((always_inline)) uint16_t ram_write_length(uint16_t opcode)
+{
+    const uint8_t X = (opcode >> 8) & 0x0F;
+    const uint8_t Y = (opcode >> 4) & 0x0F;
+
+    if ((opcode & 0xF0FF) == 0xF033) {
+        return 3;
+    }
+
+    if ((opcode & 0xF0FF) == 0xF055) {
+        return X + 1;
+    }
+
+    if ((opcode & 0xF00F) == 0x5002) {
+        return (X < Y ? Y - X : X - Y) + 1;
+    }
+
+    return 0;
+}
+
+static inline __attribute__((always_inline)) bool check_watches(chip8_object *chip8, debugger_object *debugger,
+    uint16_t length, const uint8_t *V, uint16_t I)
+{
+    for (uint16_t index = 0; index < length && debugger->watchpoint_count; index++) {
+        const uint16_t address = (uint16_t)(I + index);
+
+        if (debug_bit(debugger->watchpoints, address)) {
+            debugger->reason = DEBUG_WATCHPOINT;
+            debugger->stop_address = address;
+            return true;
+        }
+    }
+
+    if (!debugger->watched_registers) {
+        return false;
+    }
+
+    for (uint8_t index = 0; index < sizeof chip8->V; index++) {
+        if (((debugger->watched_registers >> index) & 1) && V[index] != chip8->V[index]) {
+            debugger->reason = DEBUG_REGISTER;
+            debugger->stop_register = index;
+            return true;
+        }
+    }
+
+    if (((debugger->watched_registers >> DEBUG_REGISTER_I) & 1) && I != chip8->I) {
+        debugger->reason = DEBUG_REGISTER;
+        debugger->stop_register = DEBUG_REGISTER_I;
+        return true;
+    }
+
+    return false;
+}
+
+static inline __attribute__((always_inline)) uint32_t debug_instructions(chip8_object *chip8, debugger_object *debugger,
+    uint32_t count, const uint32_t quirks)
+{
+    for (uint32_t executed = 0; executed < count; executed++) {
+        const uint16_t address = chip8->program_counter;
+
+        if (!debugger->resuming && debug_bit(debugger->breakpoints, address)) {
+            debugger->reason = DEBUG_BREAKPOINT;
+            debugger->stop_address = address;
+            return executed;
+        }
+
+        const uint16_t opcode = (chip8->ram[address] << 8) | chip8->ram[(uint16_t)(address + 1)];
+        const uint16_t I = chip8->I;
+        const uint16_t length = ram_write_length(opcode);
+        uint8_t V[sizeof chip8->V];
+        memcpy(V, chip8->V, sizeof V);
+
+        debugger->resuming = false;
+        execute_instruction(chip8, quirks);
+
+        if (check_watches(chip8, debugger, length, V, I)) {
+            return executed + 1;
+        }
+
+        if (debugger->steps && --debugger->steps == 0) {
+            debugger->reason = DEBUG_STEP;
+            debugger->stop_address = chip8->program_counter;
+            return executed + 1;
+        }
+    }
+
+    return count;
+}
+
+#define DEFINE_DEBUG_INTERPRETER(profile, name, flags)                                       \
+    static uint32_t debug_##name(chip8_object *chip8, debugger_object *debugger, uint32_t count) \
+    {                                                                                        \
+        return debug_instructions(chip8, debugger, count, flags);                            \
+    }
+
+QUIRK_PROFILES(DEFINE_DEBUG_INTERPRETER)
+
+#define INTERPRETER_ENTRY(profile, name, flags) [profile] = emulate_##name,
+#define DEBUG_INTERPRETER_ENTRY(profile, name, flags) [profile] = debug_##name,
+#define FLAGS_ENTRY(profile, name, flags) [profile] = flags,
+#define NAME_ENTRY(profile, name, flags) [profile] = #name,
+
+static const interpreter_function interpreters[QUIRKS_COUNT] = {QUIRK_PROFILES(INTERPRETER_ENTRY)};
+static const debug_interpreter_function debug_interpreters[QUIRKS_COUNT] = {QUIRK_PROFILES(DEBUG_INTERPRETER_ENTRY)};
+static const uint32_t profile_flags[QUIRKS_COUNT] = {QUIRK_PROFILES(FLAGS_ENTRY)};
+static const char *const profile_names[QUIRKS_COUNT] = {QUIRK_PROFILES(NAME_ENTRY)};
+
+void emulate_instruction(chip8_object *chip8)
+{
+    interpreters[chip8->quirks](chip8);
+}
+
+interpreter_function select_interpreter(quirk_profile profile)
+{
+    return interpreters[profile];
+}
+
+debug_interpreter_function select_debug_interpreter(quirk_profile profile)
+{
+    return debug_interpreters[profile];
+}
+
+uint32_t quirk_flags(quirk_profile profile)
+{
+    return profile_flags[profile];
+}
+
+bool parse_quirk_profile(const char *name, quirk_profile *profile)
+{
+    for (uint32_t index = 0; index < QUIRKS_COUNT; index++) {
+        if (strcmp(name, profile_names[index]) == 0) {
+            *profile = (quirk_profile)index;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *quirk_profile_name(quirk_profile profile)
+{
+    return profile_names[profile];
+}
+
+bool parse_count(const char *text, uint64_t minimum, uint64_t maximum, uint64_t *count)
+{
+    if (*text < '0' || *text > '9') {
+        return false;
+    }
+
+    char *end = NULL;
+    errno = 0;
+    const unsigned long long value = strtoull(text, &end, 10);
+
+    if (*end != '\0' || errno == ERANGE || value < minimum || value > maximum) {
+        return false;
+    }
+
+    *count = value;
+    return true;
+}
+
+typedef struct {
+    uint8_t V[16];
+    uint16_t program_counter;
+    bool key_pending;
+    uint8_t pending_key;
+} idle_state_object;
+
+static bool step_idle_state(const chip8_object *chip8, idle_state_object *state)
+{
+    if (state->program_counter > MEMORY_SIZE - 2) {
+        return false;
+    }
+
+    const uint16_t opcode = (chip8->ram[state->program_counter] << 8) | chip8->ram[state->program_counter + 1];
+    const uint8_t X = (opcode >> 8) & 0x0F;
+    const uint8_t Y = (opcode >> 4) & 0x0F;
+    const uint8_t NN = opcode & 0x0FF;
+    state->program_counter += 2;
+
+    const bool long_skip = (quirk_flags(chip8->quirks) & QUIRK_LONG_SKIP)
+        && chip8->ram[state->program_counter] == 0xF0 && chip8->ram[(uint16_t)(state->program_counter + 1)] == 0x00;
+    const uint16_t skip = long_skip ? 4 : 2;
+
+    switch ((opcode >> 12) & 0x0F)
+    {
+        case 0x00:
+            if (opcode != 0x00FD) {
+                return false;
+            }
+
+            state->program_counter -= 2;
+            return true;
+
+        case 0x01:
+            state->program_counter = opcode & 0x0FFF;
+            return true;
+
+        case 0x03:
+            state->program_counter += state->V[X] == NN ? skip : 0;
+            return true;
+
+        case 0x04:
+            state->program_counter += state->V[X] != NN ? skip : 0;
+            return true;
+
+        case 0x05:
+            if ((opcode & 0x0F) != 0) {
+                return false;
+            }
+
+            state->program_counter += state->V[X] == state->V[Y] ? skip : 0;
+            return true;
+
+        case 0x06:
+            state->V[X] = NN;
+            return true;
+
+        case 0x09:
+            state->program_counter += state->V[X] != state->V[Y] ? skip : 0;
+            return true;
+
+        case 0x0E:
+            if (state->V[X] >= sizeof chip8->keypad || (NN != 0x9E && NN != 0xA1)) {
+                return false;
+            }
+
+            state->program_counter += chip8->keypad[state->V[X]] == (NN == 0x9E) ? skip : 0;
+            return true;
+
+        case 0x0F:
+            if (NN == 0x07) {
+                state->V[X] = chip8->delay_timer;
+                return true;
+            }
+
+            if (NN != 0x0A) {
+                return false;
+            }
+
+            for (uint8_t index = 0; index < sizeof chip8->keypad; index++) {
+                if (chip8->keypad[index]) {
+                    state->pending_key = index;
+                    state->key_pending = true;
+                    break;
+                }
+            }
+
+            if (state->key_pending && !chip8->keypad[state->pending_key]) {
+                return false;
+            }
+
+            state->program_counter -= 2;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static uint32_t walk_idle_iteration(const chip8_object *chip8, idle_state_object *state)
+{
+    const uint16_t start = state->program_counter;
+
+    for (uint32_t length = 1; length <= IDLE_LOOP_LIMIT; length++) {
+        if (!step_idle_state(chip8, state)) {
+            return 0;
+        }
+
+        if (state->program_counter == start) {
+            return length;
+        }
+    }
+
+    return 0;
+}
+
+static bool same_idle_state(const idle_state_object *first, const idle_state_object *second)
+{
+    return memcmp(first->V, second->V, sizeof first->V) == 0
+        && first->key_pending == second->key_pending
+        && first->pending_key == second->pending_key;
+}
+
+bool find_idle_loop(const chip8_object *chip8, idle_loop_object *loop)
+{
+    idle_state_object initial = {
+        .program_counter = chip8->program_counter,
+        .key_pending = chip8->key_pending,
+        .pending_key = chip8->pending_key,
+    };
+    memcpy(initial.V, chip8->V, sizeof initial.V);
+
+    idle_state_object settled = initial;
+    const uint32_t settle = walk_idle_iteration(chip8, &settled);
+
+    if (settle == 0) {
+        return false;
+    }
+
+    idle_state_object repeated = settled;
+    const uint32_t length = walk_idle_iteration(chip8, &repeated);
+
+    if (length == 0 || !same_idle_state(&settled, &repeated)) {
+        return false;
+    }
+
+    loop->settle = same_idle_state(&initial, &settled) ? 0 : settle;
+    loop->length = length;
+    return true;
+}
+
+bool compare_chip8(const chip8_object *first, const chip8_object *second)
+{
+    return first->state == second->state
+        && memcmp(first->ram, second->ram, sizeof first->ram) == 0
+        && memcmp(first->display, second->display, sizeof first->display) == 0
+        && first->dirty_rows == second->dirty_rows
+        && first->hires == second->hires
+        && first->planes == second->planes
+        && memcmp(first->rpl, second->rpl, sizeof first->rpl) == 0
+        && memcmp(first->stack, second->stack, sizeof first->stack) == 0
+        && (first->stack_pointer - first->stack) == (second->stack_pointer - second->stack)
+        && memcmp(first->V, second->V, sizeof first->V) == 0
+        && first->I == second->I
+        && first->program_counter == second->program_counter
+        && first->delay_timer == second->delay_timer
+        && first->sound_timer == second->sound_timer
+        && memcmp(first->keypad, second->keypad, sizeof first->keypad) == 0
+        && first->key_pending == second->key_pending
+        && first->pending_key == second->pending_key
+        && first->rng_state == second->rng_state;
+}
+
+uint64_t hash_display(const chip8_object *chip8)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+            for (uint8_t word = 0; word < DISPLAY_WORDS; word++) {
+                hash ^= chip8->display[plane][y][word];
+                hash *= 0x100000001B3;
+                hash ^= hash >> 29;
+            }
+        }
+    }
+
+    return hash ^ chip8->hires;
+}
+
+void tick_timers(chip8_object *chip8)
+{
+    if (chip8->delay_timer > 0) {
+        chip8->delay_timer--;
+    }
+
+    if (chip8->sound_timer > 0) {
+        chip8->sound_timer--;
+    }
+}
+
+uint32_t frame_instructions(instruction_rate_object *rate)
+{
+    const uint64_t total = (uint64_t)rate->remainder + rate->instructions_per_second;
+
+    rate->remainder = total % WINDOW_HERTZ;
+    return (uint32_t)(total / WINDOW_HERTZ);
 }
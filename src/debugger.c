@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "debugger.h"
+
+void init_debugger(debugger_object *debugger)
+{
+    memset(debugger, 0, sizeof *debugger);
+}
+
+bool set_breakpoint(debugger_object *debugger, uint16_t address, bool enabled)
+{
+    const uint64_t bit = 1ULL << (address % 64);
+    uint64_t *word = &debugger->breakpoints[address / 64];
+
+    if (((*word & bit) != 0) == enabled) {
+        return false;
+    }
+
+    *word ^= bit;
+    debugger->breakpoint_count += enabled ? 1 : -1;
+    return true;
+}
+
+void set_watchpoint(debugger_object *debugger, uint16_t address, uint16_t length, bool enabled)
+{
+    for (uint32_t index = 0; index < length; index++) {
+        const uint16_t watched = (uint16_t)(address + index);
+        const uint64_t bit = 1ULL << (watched % 64);
+        uint64_t *word = &debugger->watchpoints[watched / 64];
+
+        if (((*word & bit) != 0) != enabled) {
+            *word ^= bit;
+            debugger->watchpoint_count += enabled ? 1 : -1;
+        }
+    }
+}
+
+void watch_register(debugger_object *debugger, uint8_t index, bool enabled)
+{
+    if (enabled) {
+        debugger->watched_registers |= 1U << index;
+    } else {
+        debugger->watched_registers &= ~(1U << index);
+    }
+}
+
+void resume_debugger(debugger_object *debugger, uint64_t steps)
+{
+    debugger->steps = steps;
+    debugger->resuming = true;
+    debugger->reason = DEBUG_NONE;
+}
+
+uint32_t run_debugger(debugger_object *debugger, chip8_object *chip8, uint32_t count)
+{
+    debugger->reason = DEBUG_NONE;
+    debugger->executed = select_debug_interpreter(chip8->quirks)(chip8, debugger, count);
+    return debugger->executed;
+}
+
+uint16_t disassemble_instruction(const uint8_t *ram, uint16_t address, char *text, size_t size)
+{
+    const uint16_t opcode = (ram[address] << 8) | ram[(uint16_t)(address + 1)];
+    const uint16_t NNN = opcode & 0x0FFF;
+    const uint8_t NN = opcode & 0x0FF;
+    const uint8_t N = opcode & 0x0F;
+    const uint8_t X = (opcode >> 8) & 0x0F;
+    const uint8_t Y = (opcode >> 4) & 0x0F;
+
+    switch (opcode >> 12)
+    {
+        case 0x00:
+            if (opcode == 0x00E0) {
+                snprintf(text, size, "CLS");
+            } else if (opcode == 0x00EE) {
+                snprintf(text, size, "RET");
+            } else if ((opcode & 0xFFF0) == 0x00C0) {
+                snprintf(text, size, "SCD %u", N);
+            } else if ((opcode & 0xFFF0) == 0x00D0) {
+                snprintf(text, size, "SCU %u", N);
+            } else if (opcode == 0x00FB) {
+                snprintf(text, size, "SCR");
+            } else if (opcode == 0x00FC) {
+                snprintf(text, size, "SCL");
+            } else if (opcode == 0x00FD) {
+                snprintf(text, size, "EXIT");
+            } else if (opcode == 0x00FE) {
+                snprintf(text, size, "LOW");
+            } else if (opcode == 0x00FF) {
+                snprintf(text, size, "HIGH");
+            } else {
+                snprintf(text, size, "SYS 0x%03X", NNN);
+            }
+            return 2;
+
+        case 0x01:
+            snprintf(text, size, "JP 0x%03X", NNN);
+            return 2;
+
+        case 0x02:
+            snprintf(text, size, "CALL 0x%03X", NNN);
+            return 2;
+
+        case 0x03:
+            snprintf(text, size, "SE V%X, 0x%02X", X, NN);
+            return 2;
+
+        case 0x04:
+            snprintf(text, size, "SNE V%X, 0x%02X", X, NN);
+            return 2;
+
+        case 0x05:
+            if (N == 0) {
+                snprintf(text, size, "SE V%X, V%X", X, Y);
+            } else if (N == 2) {
+                snprintf(text, size, "SAVE V%X-V%X", X, Y);
+            } else if (N == 3) {
+                snprintf(text, size, "LOAD V%X-V%X", X, Y);
+            } else {
+                break;
+            }
+            return 2;
+
+        case 0x06:
+            snprintf(text, size, "LD V%X, 0x%02X", X, NN);
+            return 2;
+
+        case 0x07:
+            snprintf(text, size, "ADD V%X, 0x%02X", X, NN);
+            return 2;
+
+        case 0x08: {
+            static const char *const names[16] = {
+                [0x0] = "LD", [0x1] = "OR", [0x2] = "AND", [0x3] = "XOR", [0x4] = "ADD",
+                [0x5] = "SUB", [0x6] = "SHR", [0x7] = "SUBN", [0xE] = "SHL"
+            };
+
+            if (!names[N]) {
+                break;
+            }
+
+            snprintf(text, size, "%s V%X, V%X", names[N], X, Y);
+            return 2;
+        }
+
+        case 0x09:
+            if (N != 0) {
+                break;
+            }
+
+            snprintf(text, size, "SNE V%X, V%X", X, Y);
+            return 2;
+
+        case 0x0A:
+            snprintf(text, size, "LD I, 0x%03X", NNN);
+            return 2;
+
+        case 0x0B:
+            snprintf(text, size, "JP V0, 0x%03X", NNN);
+            return 2;
+
+        case 0x0C:
+            snprintf(text, size, "RND V%X, 0x%02X", X, NN);
+            return 2;
+
+        case 0x0D:
+            snprintf(text, size, "DRW V%X, V%X, %u", X, Y, N);
+            return 2;
+
+        case 0x0E:
+            if (NN == 0x9E) {
+                snprintf(text, size, "SKP V%X", X);
+            } else if (NN == 0xA1) {
+                snprintf(text, size, "SKNP V%X", X);
+            } else {
+                break;
+            }
+            return 2;
+
+        case 0x0F:
+            switch (NN)
+            {
+                case 0x00:
+                    if (X != 0) {
+                        break;
+                    }
+
+                    snprintf(text, size, "LD I, 0x%04X", (ram[(uint16_t)(address + 2)] << 8) | ram[(uint16_t)(address + 3)]);
+                    return 4;
+
+                case 0x01:
+                    snprintf(text, size, "PLANE %u", X);
+                    return 2;
+
+                case 0x07:
+                    snprintf(text, size, "LD V%X, DT", X);
+                    return 2;
+
+                case 0x0A:
+                    snprintf(text, size, "LD V%X, K", X);
+                    return 2;
+
+                case 0x15:
+                    snprintf(text, size, "LD DT, V%X", X);
+                    return 2;
+
+                case 0x18:
+                    snprintf(text, size, "LD ST, V%X", X);
+                    return 2;
+
+                case 0x1E:
+                    snprintf(text, size, "ADD I, V%X", X);
+                    return 2;
+
+                case 0x29:
+                    snprintf(text, size, "LD F, V%X", X);
+                    return 2;
+
+                case 0x30:
+                    snprintf(text, size, "LD HF, V%X", X);
+                    return 2;
+
+                case 0x33:
+                    snprintf(text, size, "LD B, V%X", X);
+                    return 2;
+
+                case 0x55:
+                    snprintf(text, size, "LD [I], V%X", X);
+                    return 2;
+
+                case 0x65:
+                    snprintf(text, size, "LD V%X, [I]", X);
+                    return 2;
+
+                case 0x75:
+                    snprintf(text, size, "LD R, V%X", X);
+                    return 2;
+
+                case 0x85:
+                    snprintf(text, size, "LD V%X, R", X);
+                    return 2;
+
+                default:
+                    break;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    snprintf(text, size, "DW 0x%04X", opcode);
+    return 2;
+}
@@ -0,0 +1,131 @@
+#include <string.h>
+
+#include "debugger.h"
+#include "engine.h"
+
+bool parse_engine_type(const char *name, engine_type *type)
+{
+    if (strcmp(name, "switch") == 0) {
+        *type = ENGINE_SWITCH;
+        return true;
+    }
+
+    if (strcmp(name, "threaded") == 0) {
+        *type = ENGINE_THREADED;
+        return true;
+    }
+
+    if (strcmp(name, "jit") == 0) {
+        *type = ENGINE_JIT;
+        return true;
+    }
+
+    return false;
+}
+
+bool init_engine(engine_object *engine, engine_type type)
+{
+    engine->type = type;
+    engine->restore_count = 0;
+    engine->debugger = NULL;
+    engine->debugging = false;
+
+    if (type == ENGINE_JIT) {
+        return init_jit(&engine->jit);
+    }
+
+    reset_engine(engine);
+    return true;
+}
+
+void destroy_engine(engine_object *engine)
+{
+    if (engine->type == ENGINE_JIT) {
+        destroy_jit(&engine->jit);
+    }
+}
+
+void reset_engine(engine_object *engine)
+{
+    switch (engine->type)
+    {
+        case ENGINE_THREADED:
+            reset_threaded(&engine->threaded);
+            break;
+
+        case ENGINE_JIT:
+            reset_jit(&engine->jit);
+            break;
+
+        case ENGINE_SWITCH:
+        default:
+            break;
+    }
+}
+
+static void run_instructions(engine_object *engine, chip8_object *chip8, uint32_t count)
+{
+    switch (engine->type)
+    {
+        case ENGINE_THREADED:
+            run_threaded(&engine->threaded, chip8, count);
+            break;
+
+        case ENGINE_JIT:
+            run_jit(&engine->jit, chip8, count);
+            break;
+
+        case ENGINE_SWITCH:
+        default: {
+            const interpreter_function interpret = select_interpreter(chip8->quirks);
+
+            for (uint32_t index = 0; index < count; index++) {
+                interpret(chip8);
+            }
+            break;
+        }
+    }
+}
+
+bool run_engine(engine_object *engine, chip8_object *chip8, uint32_t count)
+{
+    if (engine->restore_count != chip8->restore_count) {
+        reset_engine(engine);
+        engine->restore_count = chip8->restore_count;
+    }
+
+    if (engine->debugger) {
+        if (debugger_armed(engine->debugger)) {
+            engine->debugging = true;
+            run_debugger(engine->debugger, chip8, count);
+            return false;
+        }
+
+        if (engine->debugging) {
+            reset_engine(engine);
+            engine->debugging = false;
+        }
+
+        engine->debugger->reason = DEBUG_NONE;
+        engine->debugger->resuming = false;
+        engine->debugger->executed = count;
+    }
+
+#ifdef CHIP8_TRACE
+    if (chip8->trace) {
+        run_instructions(engine, chip8, count);
+        return false;
+    }
+#endif
+
+    idle_loop_object loop;
+
+    if (!find_idle_loop(chip8, &loop) || loop.settle >= count) {
+        run_instructions(engine, chip8, count);
+        return false;
+    }
+
+    run_instructions(engine, chip8, loop.settle);
+    run_instructions(engine, chip8, (count - loop.settle) % loop.length);
+    return true;
+}
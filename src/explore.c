@@ -0,0 +1,651 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "instance_pool.h"
+#include "state_set.h"
+
+#define DEFAULT_STATE_LIMIT 1000000
+#define DEFAULT_FRAME_LIMIT 600
+#define COVERAGE_WORDS (MEMORY_SIZE / 64)
+#define ROOT_NODE 0
+
+typedef enum {
+    INPUT_NONE,
+    INPUT_RELEASE,
+    INPUT_PRESS,
+    INPUT_TAP
+} input_action;
+
+typedef struct {
+    uint32_t parent;
+    uint32_t frame;
+    uint8_t key;
+    uint8_t action;
+} node_object;
+
+typedef struct {
+    uint64_t hash;
+    node_object step;
+    uint32_t frame;
+} screen_object;
+
+typedef struct {
+    compact_chip8_object state;
+    uint32_t node;
+    uint32_t frame;
+    uint32_t frame_step;
+} frontier_item_object;
+
+typedef struct {
+    pthread_mutex_t lock;
+    frontier_item_object **items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} frontier_object;
+
+typedef struct {
+    instance_pool_object *pool;
+    interpreter_function interpret;
+    uint32_t instructions_per_frame;
+    uint32_t frame_limit;
+    uint32_t state_limit;
+    node_object *nodes;
+    atomic_uint node_count;
+    screen_object *screens;
+    atomic_uint screen_count;
+    state_set_object states;
+    state_set_object screen_hashes;
+    frontier_object *frontiers;
+    uint32_t worker_count;
+    atomic_size_t pending;
+    atomic_bool truncated;
+} explorer_object;
+
+typedef struct {
+    explorer_object *explorer;
+    uint32_t id;
+    pthread_t thread;
+    bool started;
+    chip8_object *chip8;
+    uint64_t instructions;
+    uint64_t coverage[COVERAGE_WORDS];
+} worker_object;
+
+typedef struct {
+    node_object step;
+    uint32_t frame;
+    uint32_t frame_step;
+} run_object;
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1000.0 + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static uint16_t next_opcode(const chip8_object *chip8)
+{
+    return (chip8->ram[chip8->program_counter] << 8) | chip8->ram[(uint16_t)(chip8->program_counter + 1)];
+}
+
+static bool input_opcode(uint16_t opcode)
+{
+    const uint16_t pattern = opcode & 0xF0FF;
+    return pattern == 0xE09E || pattern == 0xE0A1 || pattern == 0xF00A;
+}
+
+static bool push_item(frontier_object *frontier, frontier_item_object *item)
+{
+    pthread_mutex_lock(&frontier->lock);
+
+    if (frontier->tail == frontier->capacity && frontier->head > 0) {
+        memmove(frontier->items, &frontier->items[frontier->head], (frontier->tail - frontier->head) * sizeof *frontier->items);
+        frontier->tail -= frontier->head;
+        frontier->head = 0;
+    }
+
+    if (frontier->tail == frontier->capacity) {
+        const size_t capacity = frontier->capacity ? frontier->capacity * 2 : 256;
+        frontier_item_object **items = realloc(frontier->items, capacity * sizeof *items);
+
+        if (!items) {
+            pthread_mutex_unlock(&frontier->lock);
+            fprintf(stderr, "Could not grow exploration frontier\n");
+            return false;
+        }
+
+        frontier->items = items;
+        frontier->capacity = capacity;
+    }
+
+    frontier->items[frontier->tail++] = item;
+    pthread_mutex_unlock(&frontier->lock);
+    return true;
+}
+
+static frontier_item_object *pop_item(frontier_object *frontier)
+{
+    frontier_item_object *item = NULL;
+
+    pthread_mutex_lock(&frontier->lock);
+
+    if (frontier->head < frontier->tail) {
+        item = frontier->items[--frontier->tail];
+    }
+
+    pthread_mutex_unlock(&frontier->lock);
+    return item;
+}
+
+static frontier_item_object *steal_item(frontier_object *frontier)
+{
+    frontier_item_object *item = NULL;
+
+    pthread_mutex_lock(&frontier->lock);
+
+    if (frontier->head < frontier->tail) {
+        item = frontier->items[frontier->head++];
+    }
+
+    pthread_mutex_unlock(&frontier->lock);
+    return item;
+}
+
+static frontier_item_object *next_item(explorer_object *explorer, uint32_t id)
+{
+    frontier_item_object *item = pop_item(&explorer->frontiers[id]);
+
+    for (uint32_t offset = 1; !item && offset < explorer->worker_count; offset++) {
+        item = steal_item(&explorer->frontiers[(id + offset) % explorer->worker_count]);
+    }
+
+    return item;
+}
+
+static void record_screen(explorer_object *explorer, chip8_object *chip8, const run_object *run)
+{
+    if (!chip8->dirty_rows) {
+        return;
+    }
+
+    chip8->dirty_rows = 0;
+
+    const uint64_t hash = hash_display(chip8);
+    const state_insert_result result = insert_state(&explorer->screen_hashes, hash);
+
+    if (result == STATE_FULL) {
+        atomic_store_explicit(&explorer->truncated, true, memory_order_relaxed);
+        return;
+    }
+
+    if (result == STATE_ADDED) {
+        const uint32_t index = atomic_fetch_add_explicit(&explorer->screen_count, 1, memory_order_relaxed);
+        explorer->screens[index] = (screen_object){.hash = hash, .step = run->step, .frame = run->frame};
+    }
+}
+
+static bool execute(worker_object *worker, run_object *run)
+{
+    explorer_object *explorer = worker->explorer;
+    chip8_object *chip8 = worker->chip8;
+
+    if (run->frame >= explorer->frame_limit) {
+        return false;
+    }
+
+    worker->coverage[chip8->program_counter / 64] |= 1ULL << (chip8->program_counter % 64);
+    explorer->interpret(chip8);
+    worker->instructions++;
+
+    if (++run->frame_step == explorer->instructions_per_frame) {
+        tick_timers(chip8);
+        run->frame_step = 0;
+        run->frame++;
+        record_screen(explorer, chip8, run);
+    }
+
+    return true;
+}
+
+static void add_state(worker_object *worker, const run_object *run)
+{
+    explorer_object *explorer = worker->explorer;
+    frontier_item_object *item = calloc(1, sizeof *item);
+
+    if (!item || !store_compact_chip8(explorer->pool, &item->state, worker->chip8)) {
+        fprintf(stderr, "Could not store explored state\n");
+        atomic_store_explicit(&explorer->truncated, true, memory_order_relaxed);
+
+        if (item) {
+            release_compact_chip8(&item->state);
+        }
+
+        free(item);
+        return;
+    }
+
+    const uint64_t hash = hash_compact_chip8(&item->state) ^ ((uint64_t)run->frame_step * 0x9E3779B97F4A7C15);
+    const state_insert_result result = insert_state(&explorer->states, hash);
+
+    if (result != STATE_ADDED) {
+        if (result == STATE_FULL) {
+            atomic_store_explicit(&explorer->truncated, true, memory_order_relaxed);
+        }
+
+        release_compact_chip8(&item->state);
+        free(item);
+        return;
+    }
+
+    item->node = atomic_fetch_add_explicit(&explorer->node_count, 1, memory_order_relaxed);
+    item->frame = run->frame;
+    item->frame_step = run->frame_step;
+    explorer->nodes[item->node] = run->step;
+    atomic_fetch_add_explicit(&explorer->pending, 1, memory_order_relaxed);
+
+    if (!push_item(&explorer->frontiers[worker->id], item)) {
+        atomic_fetch_sub_explicit(&explorer->pending, 1, memory_order_relaxed);
+        atomic_store_explicit(&explorer->truncated, true, memory_order_relaxed);
+        release_compact_chip8(&item->state);
+        free(item);
+    }
+}
+
+static void explore_input(worker_object *worker, const frontier_item_object *item, uint8_t key, input_action action)
+{
+    chip8_object *chip8 = worker->chip8;
+    run_object run = {
+        .step = {.parent = item->node, .frame = item->frame, .key = key, .action = action},
+        .frame = item->frame,
+        .frame_step = item->frame_step,
+    };
+
+    load_compact_chip8(worker->explorer->pool, &item->state, chip8);
+
+    switch (action) {
+    case INPUT_RELEASE:
+        chip8->keypad[key] = false;
+        break;
+
+    case INPUT_PRESS:
+        chip8->keypad[key] = true;
+        break;
+
+    case INPUT_TAP:
+        memset(chip8->keypad, 0, sizeof chip8->keypad);
+        chip8->keypad[key] = true;
+
+        if (!execute(worker, &run)) {
+            return;
+        }
+
+        chip8->keypad[key] = false;
+        break;
+
+    default:
+        break;
+    }
+
+    if (!execute(worker, &run)) {
+        return;
+    }
+
+    while (!input_opcode(next_opcode(chip8))) {
+        if (!execute(worker, &run)) {
+            return;
+        }
+    }
+
+    add_state(worker, &run);
+}
+
+static void expand_item(worker_object *worker, const frontier_item_object *item)
+{
+    chip8_object *chip8 = worker->chip8;
+
+    load_compact_chip8(worker->explorer->pool, &item->state, chip8);
+
+    const uint16_t opcode = next_opcode(chip8);
+    const uint8_t key = chip8->V[(opcode >> 8) & 0xF] & 0xF;
+
+    if (!input_opcode(opcode)) {
+        explore_input(worker, item, 0, INPUT_NONE);
+    } else if ((opcode & 0xF0FF) == 0xF00A) {
+        for (uint8_t tapped = 0; tapped < 16; tapped++) {
+            explore_input(worker, item, tapped, INPUT_TAP);
+        }
+    } else {
+        explore_input(worker, item, key, INPUT_RELEASE);
+        explore_input(worker, item, key, INPUT_PRESS);
+    }
+}
+
+static void *worker_main(void *argument)
+{
+    worker_object *worker = argument;
+    explorer_object *explorer = worker->explorer;
+
+    for (;;) {
+        frontier_item_object *item = next_item(explorer, worker->id);
+
+        if (!item) {
+            if (atomic_load_explicit(&explorer->pending, memory_order_acquire) == 0) {
+                break;
+            }
+
+            sched_yield();
+            continue;
+        }
+
+        expand_item(worker, item);
+        release_compact_chip8(&item->state);
+        free(item);
+        atomic_fetch_sub_explicit(&explorer->pending, 1, memory_order_acq_rel);
+    }
+
+    return NULL;
+}
+
+static void print_path(const explorer_object *explorer, const node_object *step)
+{
+    static const char actions[] = {' ', '-', '+', '*'};
+    uint32_t depth = 1;
+
+    for (uint32_t node = step->parent; node != ROOT_NODE; node = explorer->nodes[node].parent) {
+        depth++;
+    }
+
+    const node_object **path = malloc(depth * sizeof *path);
+
+    if (!path) {
+        printf("null");
+        return;
+    }
+
+    uint32_t length = 0;
+    bool separator = false;
+
+    path[length++] = step;
+
+    for (uint32_t node = step->parent; node != ROOT_NODE; node = explorer->nodes[node].parent) {
+        path[length++] = &explorer->nodes[node];
+    }
+
+    putchar('"');
+
+    while (length-- > 0) {
+        if (path[length]->action != INPUT_NONE) {
+            printf("%s%u:%X%c", separator ? " " : "", path[length]->frame, path[length]->key, actions[path[length]->action]);
+            separator = true;
+        }
+    }
+
+    putchar('"');
+    free(path);
+}
+
+static int compare_screens(const void *first, const void *second)
+{
+    const screen_object *a = first;
+    const screen_object *b = second;
+
+    if (a->frame != b->frame) {
+        return a->frame < b->frame ? -1 : 1;
+    }
+
+    return a->hash < b->hash ? -1 : a->hash > b->hash;
+}
+
+static bool pc_covered(const uint64_t *coverage, uint32_t address)
+{
+    return address < MEMORY_SIZE && ((coverage[address / 64] >> (address % 64)) & 1);
+}
+
+static void print_coverage(const uint64_t *coverage)
+{
+    uint32_t covered = 0;
+    bool separator = false;
+
+    printf("\"coverage\":\"");
+
+    for (uint32_t address = 0; address < MEMORY_SIZE; address++) {
+        if (!pc_covered(coverage, address)) {
+            continue;
+        }
+
+        uint32_t last = address;
+        covered++;
+
+        while (pc_covered(coverage, last + 1) || pc_covered(coverage, last + 2)) {
+            last += pc_covered(coverage, last + 1) ? 1 : 2;
+            covered++;
+        }
+
+        printf("%s%03x", separator ? "," : "", address);
+
+        if (last != address) {
+            printf("-%03x", last);
+        }
+
+        separator = true;
+        address = last;
+    }
+
+    printf("\",\"covered_pcs\":%u", covered);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: %s <rom> [--threads N] [--states N] [--frames N] [--seed N] [--ips N]\n"
+               "       [--quirks vip|chip48|schip|xochip]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    explorer_object explorer = {.state_limit = DEFAULT_STATE_LIMIT, .frame_limit = DEFAULT_FRAME_LIMIT};
+    uint32_t instructions_per_second = INSTRUCTIONS_PER_SECOND;
+    uint32_t seed = 1;
+    quirk_profile quirks = QUIRKS_VIP;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    explorer.worker_count = cores > 0 ? (uint32_t)cores : 1;
+
+    for (int index = 2; index < argc; index++) {
+        if (strcmp(argv[index], "--threads") == 0 && index + 1 < argc) {
+            uint64_t threads = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &threads)) {
+                printf("Invalid thread count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            explorer.worker_count = (uint32_t)threads;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--states") == 0 && index + 1 < argc) {
+            uint64_t states = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &states)) {
+                printf("Invalid state limit %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            explorer.state_limit = (uint32_t)states;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--frames") == 0 && index + 1 < argc) {
+            uint64_t frames = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &frames)) {
+                printf("Invalid frame limit %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            explorer.frame_limit = (uint32_t)frames;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--seed") == 0 && index + 1 < argc) {
+            uint64_t value = 0;
+
+            if (!parse_count(argv[++index], 0, UINT32_MAX, &value)) {
+                printf("Invalid seed %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            seed = (uint32_t)value;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--ips") == 0 && index + 1 < argc) {
+            uint64_t rate = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &rate)) {
+                printf("Invalid instruction rate %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            instructions_per_second = (uint32_t)rate;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--quirks") == 0 && index + 1 < argc) {
+            if (!parse_quirk_profile(argv[++index], &quirks)) {
+                printf("Unknown quirk profile %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        printf("Unknown option %s\n", argv[index]);
+        exit(EXIT_FAILURE);
+    }
+
+    explorer.instructions_per_frame = instructions_per_second / WINDOW_HERTZ;
+
+    if (explorer.state_limit == 0 || explorer.instructions_per_frame == 0) {
+        printf("State limit and instructions per frame must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    chip8_object *prototype = calloc(1, sizeof *prototype);
+    explorer.pool = malloc(sizeof *explorer.pool);
+
+    if (!prototype || !explorer.pool || !init_chip8(prototype, argv[1])) {
+        exit(EXIT_FAILURE);
+    }
+
+    prototype->quirks = quirks;
+    seed_chip8(prototype, seed);
+
+    if (!init_instance_pool(explorer.pool, prototype, 1)
+        || !init_state_set(&explorer.states, explorer.state_limit)
+        || !init_state_set(&explorer.screen_hashes, explorer.state_limit)) {
+        exit(EXIT_FAILURE);
+    }
+
+    explorer.interpret = select_interpreter(quirks);
+    explorer.nodes = calloc(explorer.state_limit, sizeof *explorer.nodes);
+    explorer.screens = calloc(explorer.state_limit, sizeof *explorer.screens);
+    explorer.frontiers = calloc(explorer.worker_count, sizeof *explorer.frontiers);
+    worker_object *workers = calloc(explorer.worker_count, sizeof *workers);
+    frontier_item_object *root = calloc(1, sizeof *root);
+
+    if (!explorer.nodes || !explorer.screens || !explorer.frontiers || !workers || !root
+        || !store_compact_chip8(explorer.pool, &root->state, prototype)) {
+        fprintf(stderr, "Could not allocate explorer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    atomic_init(&explorer.node_count, 1);
+    atomic_init(&explorer.screen_count, 0);
+    atomic_init(&explorer.pending, 1);
+    atomic_init(&explorer.truncated, false);
+    insert_state(&explorer.states, hash_compact_chip8(&root->state));
+
+    for (uint32_t id = 0; id < explorer.worker_count; id++) {
+        pthread_mutex_init(&explorer.frontiers[id].lock, NULL);
+    }
+
+    push_item(&explorer.frontiers[0], root);
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint32_t id = 0; id < explorer.worker_count; id++) {
+        workers[id] = (worker_object){.explorer = &explorer, .id = id, .chip8 = malloc(sizeof *workers[id].chip8)};
+
+        if (!workers[id].chip8) {
+            fprintf(stderr, "Could not allocate explorer worker\n");
+            exit(EXIT_FAILURE);
+        }
+
+        *workers[id].chip8 = *prototype;
+        init_pool_worker(explorer.pool, workers[id].chip8);
+        workers[id].started = pthread_create(&workers[id].thread, NULL, worker_main, &workers[id]) == 0;
+
+        if (!workers[id].started) {
+            fprintf(stderr, "Could not start explorer worker %u, running it inline\n", id);
+        }
+    }
+
+    uint64_t instructions = 0;
+
+    for (uint32_t id = 0; id < explorer.worker_count; id++) {
+        if (workers[id].started) {
+            pthread_join(workers[id].thread, NULL);
+        } else {
+            worker_main(&workers[id]);
+        }
+
+        instructions += workers[id].instructions;
+
+        for (uint32_t word = 0; word < COVERAGE_WORDS; word++) {
+            workers[0].coverage[word] |= workers[id].coverage[word];
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const uint32_t screen_count = atomic_load(&explorer.screen_count);
+
+    qsort(explorer.screens, screen_count, sizeof *explorer.screens, compare_screens);
+
+    for (uint32_t index = 0; index < screen_count; index++) {
+        printf("{\"screen\":\"%016llx\",\"frame\":%u,\"path\":",
+            (unsigned long long)explorer.screens[index].hash, explorer.screens[index].frame);
+        print_path(&explorer, &explorer.screens[index].step);
+        printf("}\n");
+    }
+
+    printf("{\"rom\":\"%s\",\"states\":%u,\"screens\":%u,", argv[1], atomic_load(&explorer.node_count), screen_count);
+    print_coverage(workers[0].coverage);
+    printf(",\"truncated\":%s}\n", atomic_load(&explorer.truncated) ? "true" : "false");
+
+    fprintf(stderr, "Explored %u states, %u screens, %llu instructions on %u threads in %.3f ms\n",
+        atomic_load(&explorer.node_count), screen_count, (unsigned long long)instructions,
+        explorer.worker_count, elapsed_ms(&start, &end));
+
+    for (uint32_t id = 0; id < explorer.worker_count; id++) {
+        free(workers[id].chip8);
+        free(explorer.frontiers[id].items);
+        pthread_mutex_destroy(&explorer.frontiers[id].lock);
+    }
+
+    free(workers);
+    free(explorer.frontiers);
+    free(explorer.screens);
+    free(explorer.nodes);
+    destroy_state_set(&explorer.states);
+    destroy_state_set(&explorer.screen_hashes);
+    destroy_instance_pool(explorer.pool);
+    free(explorer.pool);
+    free(prototype);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,609 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chip8.h"
+#include "debugger.h"
+#include "engine.h"
+#include "input_script.h"
+#include "profile.h"
+#include "rom_library.h"
+#include "snapshot.h"
+#include "trace.h"
+
+static void print_registers(const chip8_object *chip8)
+{
+    printf("PC: 0x%03X I: 0x%03X DT: %u ST: %u SP: %u\n",
+        chip8->program_counter,
+        chip8->I,
+        chip8->delay_timer,
+        chip8->sound_timer,
+        (unsigned)(chip8->stack_pointer - chip8->stack));
+
+    for (uint8_t index = 0; index < sizeof chip8->V; index++) {
+        printf("V%X: 0x%02X%c", index, chip8->V[index], (index % 8 == 7) ? '\n' : ' ');
+    }
+}
+
+static void print_display(const chip8_object *chip8)
+{
+    for (uint32_t y = 0; y < SCREEN_HEIGHT(chip8->hires); y++) {
+        for (uint32_t x = 0; x < SCREEN_WIDTH(chip8->hires); x++) {
+            uint8_t color = 0;
+
+            for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+                color |= DISPLAY_PIXEL(chip8->display[plane], x, y) << plane;
+            }
+
+            putchar(".#+@"[color]);
+        }
+        putchar('\n');
+    }
+}
+
+static void dump_state(const chip8_object *chip8, uint64_t cycles, uint64_t frames)
+{
+    printf("cycles: %llu\n", (unsigned long long)cycles);
+    printf("frames: %llu\n", (unsigned long long)frames);
+    print_registers(chip8);
+    print_display(chip8);
+}
+
+static bool parse_address(const char *text, uint16_t *address)
+{
+    char *end = NULL;
+    const unsigned long value = strtoul(text, &end, 16);
+
+    if (end == text || *end != '\0' || value >= MEMORY_SIZE) {
+        return false;
+    }
+
+    *address = (uint16_t)value;
+    return true;
+}
+
+static bool parse_register(const char *text, uint8_t *index)
+{
+    if ((text[0] == 'I' || text[0] == 'i') && text[1] == '\0') {
+        *index = DEBUG_REGISTER_I;
+        return true;
+    }
+
+    if ((text[0] != 'V' && text[0] != 'v') || text[1] == '\0' || text[2] != '\0') {
+        return false;
+    }
+
+    char *end = NULL;
+    *index = (uint8_t)strtoul(text + 1, &end, 16);
+    return *end == '\0';
+}
+
+static void print_disassembly(const chip8_object *chip8, const debugger_object *debugger, uint16_t address, uint32_t count)
+{
+    for (uint32_t index = 0; index < count; index++) {
+        char text[DEBUG_TEXT_SIZE];
+        const uint16_t length = disassemble_instruction(chip8->ram, address, text, sizeof text);
+
+        printf("%c%c %04X: %02X%02X  %s\n",
+            address == chip8->program_counter ? '>' : ' ',
+            debug_bit(debugger->breakpoints, address) ? '*' : ' ',
+            address,
+            chip8->ram[address],
+            chip8->ram[(uint16_t)(address + 1)],
+            text);
+
+        address += length;
+    }
+}
+
+static void print_memory(const chip8_object *chip8, uint16_t address, uint32_t length)
+{
+    for (uint32_t index = 0; index < length; index++) {
+        const uint16_t current = (uint16_t)(address + index);
+
+        if (index % 16 == 0) {
+            printf("%04X:", current);
+        }
+
+        printf(" %02X", chip8->ram[current]);
+
+        if (index % 16 == 15 || index + 1 == length) {
+            putchar('\n');
+        }
+    }
+}
+
+static void print_stop(const chip8_object *chip8, const debugger_object *debugger)
+{
+    switch (debugger->reason)
+    {
+        case DEBUG_BREAKPOINT:
+            printf("Breakpoint at 0x%04X\n", debugger->stop_address);
+            break;
+
+        case DEBUG_WATCHPOINT:
+            printf("Watchpoint at 0x%04X = 0x%02X\n", debugger->stop_address, chip8->ram[debugger->stop_address]);
+            break;
+
+        case DEBUG_REGISTER:
+            if (debugger->stop_register == DEBUG_REGISTER_I) {
+                printf("I = 0x%04X\n", chip8->I);
+            } else {
+                printf("V%X = 0x%02X\n", debugger->stop_register, chip8->V[debugger->stop_register]);
+            }
+            break;
+
+        case DEBUG_STEP:
+        case DEBUG_NONE:
+        default:
+            break;
+    }
+
+    print_disassembly(chip8, debugger, chip8->program_counter, 1);
+}
+
+static void print_debug_help(void)
+{
+    printf("c                 continue\n"
+           "s [N]             step N instructions\n"
+           "b ADDR | db ADDR  set or delete a breakpoint\n"
+           "w ADDR [N]        watch writes to N bytes (dw deletes)\n"
+           "r REG | dr REG    watch or unwatch V0-VF or I\n"
+           "l [ADDR] [N]      disassemble N instructions\n"
+           "x ADDR [N]        dump N bytes of memory\n"
+           "p                 print registers\n"
+           "v                 print display\n"
+           "q                 quit\n");
+}
+
+static bool debug_prompt(chip8_object *chip8, debugger_object *debugger)
+{
+    char line[128];
+
+    print_stop(chip8, debugger);
+
+    for (;;) {
+        printf("(chip8) ");
+        fflush(stdout);
+
+        if (!fgets(line, sizeof line, stdin)) {
+            return false;
+        }
+
+        char command[16];
+        char first[32] = "";
+        char second[32] = "";
+        const int fields = sscanf(line, "%15s %31s %31s", command, first, second);
+        uint16_t address = chip8->program_counter;
+        uint8_t index = 0;
+
+        if (fields <= 0) {
+            continue;
+        }
+
+        if (strcmp(command, "c") == 0) {
+            resume_debugger(debugger, 0);
+            return true;
+        }
+
+        if (strcmp(command, "s") == 0) {
+            const uint64_t steps = fields > 1 ? strtoull(first, NULL, 10) : 1;
+            resume_debugger(debugger, steps ? steps : 1);
+            return true;
+        }
+
+        if (strcmp(command, "q") == 0) {
+            return false;
+        }
+
+        if ((strcmp(command, "b") == 0 || strcmp(command, "db") == 0) && fields > 1 && parse_address(first, &address)) {
+            set_breakpoint(debugger, address, command[0] == 'b');
+            continue;
+        }
+
+        if ((strcmp(command, "w") == 0 || strcmp(command, "dw") == 0) && fields > 1 && parse_address(first, &address)) {
+            const uint16_t length = fields > 2 ? (uint16_t)strtoul(second, NULL, 10) : 1;
+            set_watchpoint(debugger, address, length, command[0] == 'w');
+            continue;
+        }
+
+        if ((strcmp(command, "r") == 0 || strcmp(command, "dr") == 0) && fields > 1 && parse_register(first, &index)) {
+            watch_register(debugger, index, command[0] == 'r');
+            continue;
+        }
+
+        if (strcmp(command, "l") == 0 && (fields < 2 || parse_address(first, &address))) {
+            print_disassembly(chip8, debugger, address, fields > 2 ? (uint32_t)strtoul(second, NULL, 10) : 8);
+            continue;
+        }
+
+        if (strcmp(command, "x") == 0 && fields > 1 && parse_address(first, &address)) {
+            print_memory(chip8, address, fields > 2 ? (uint32_t)strtoul(second, NULL, 10) : 16);
+            continue;
+        }
+
+        if (strcmp(command, "p") == 0) {
+            print_registers(chip8);
+            continue;
+        }
+
+        if (strcmp(command, "v") == 0) {
+            print_display(chip8);
+            continue;
+        }
+
+        if (strcmp(command, "h") != 0) {
+            printf("Invalid command %s", line);
+        }
+
+        print_debug_help();
+    }
+}
+
+static bool run_debugged(engine_object *engine, chip8_object *chip8, debugger_object *debugger, uint32_t count)
+{
+    uint32_t executed = 0;
+
+    while (executed < count) {
+        run_engine(engine, chip8, count - executed);
+        executed += debugger->executed;
+
+        if (debugger->reason != DEBUG_NONE && !debug_prompt(chip8, debugger)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#ifdef CHIP8_TRACE
+static bool finish_trace(trace_object *trace)
+{
+    const bool written = stop_trace(trace);
+
+    fprintf(stderr, "trace: %llu records, %llu bytes (%.2f bytes/record), %llu stalls\n",
+        (unsigned long long)trace->records_written,
+        (unsigned long long)trace->bytes_written,
+        trace->records_written ? (double)trace->bytes_written / trace->records_written : 0.0,
+        (unsigned long long)trace->stalls);
+
+    return written;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: %s <rom> [--instructions N | --frames N] [--seed N] [--engine switch|threaded|jit] [--compare]\n"
+               "       [--ips N] [--quirks vip|chip48|schip|xochip] [--load-state FILE] [--save-state FILE]\n"
+               "       [--replay MOVIE] [--library PATH] [--trace FILE] [--debug]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t instructions_per_second = INSTRUCTIONS_PER_SECOND;
+    uint64_t instruction_limit = 0;
+    uint64_t frame_limit = WINDOW_HERTZ * 10;
+    bool limit_given = false;
+    uint64_t seed = 0;
+    bool seeded = false;
+    engine_type engine_kind = ENGINE_SWITCH;
+    bool compare = false;
+    const char *load_state = NULL;
+    const char *save_state = NULL;
+    const char *replay = NULL;
+    const char *library_path = NULL;
+    const char *trace_path = NULL;
+    bool debug = false;
+    bool rate_given = false;
+    quirk_profile quirks = QUIRKS_VIP;
+    bool quirks_given = false;
+
+    for (int index = 2; index < argc; index++) {
+        if (strcmp(argv[index], "--instructions") == 0 && index + 1 < argc) {
+            if (!parse_count(argv[++index], 1, UINT64_MAX, &instruction_limit)) {
+                printf("Invalid instruction count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            frame_limit = 0;
+            limit_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--frames") == 0 && index + 1 < argc) {
+            if (!parse_count(argv[++index], 1, UINT64_MAX, &frame_limit)) {
+                printf("Invalid frame count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            instruction_limit = 0;
+            limit_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--seed") == 0 && index + 1 < argc) {
+            if (!parse_count(argv[++index], 0, UINT32_MAX, &seed)) {
+                printf("Invalid seed %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            seeded = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--engine") == 0 && index + 1 < argc) {
+            if (!parse_engine_type(argv[++index], &engine_kind)) {
+                printf("Unknown engine %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[index], "--ips") == 0 && index + 1 < argc) {
+            uint64_t rate = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &rate)) {
+                printf("Invalid instruction rate %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            instructions_per_second = (uint32_t)rate;
+            rate_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--quirks") == 0 && index + 1 < argc) {
+            if (!parse_quirk_profile(argv[++index], &quirks)) {
+                printf("Unknown quirk profile %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            quirks_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--compare") == 0) {
+            compare = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--load-state") == 0 && index + 1 < argc) {
+            load_state = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--save-state") == 0 && index + 1 < argc) {
+            save_state = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--replay") == 0 && index + 1 < argc) {
+            replay = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--library") == 0 && index + 1 < argc) {
+            library_path = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--trace") == 0 && index + 1 < argc) {
+            trace_path = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--debug") == 0) {
+            debug = true;
+            continue;
+        }
+
+        printf("Unknown option %s\n", argv[index]);
+        exit(EXIT_FAILURE);
+    }
+
+#ifndef CHIP8_TRACE
+    if (trace_path) {
+        printf("Tracing needs a build with TRACE=1\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    if (trace_path && engine_kind != ENGINE_SWITCH) {
+        printf("Traces only cover the switch engine, --trace cannot be used with --engine threaded or jit\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *rom_name = argv[1];
+    rom_library_object library = {0};
+    const rom_entry_object *rom = NULL;
+
+    if (library_path) {
+        if (!open_rom_library(&library, library_path)) {
+            exit(EXIT_FAILURE);
+        }
+
+        rom = find_rom(&library, rom_name);
+
+        if (!rom) {
+            printf("Rom %s is not in library %s\n", rom_name, library_path);
+            exit(EXIT_FAILURE);
+        }
+
+        if (!rate_given && rom->metadata.instructions_per_second > 0) {
+            instructions_per_second = rom->metadata.instructions_per_second;
+        }
+
+        if (!quirks_given && rom->metadata.quirks[0] && !parse_quirk_profile(rom->metadata.quirks, &quirks)) {
+            printf("Rom %s has unknown quirk profile %s\n", rom->name, rom->metadata.quirks);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    movie_object movie = {0};
+
+    if (replay) {
+        if (!load_movie(&movie, replay)) {
+            exit(EXIT_FAILURE);
+        }
+
+        if (movie.instructions_per_second == 0) {
+            printf("Movie %s has no instruction rate\n", replay);
+            exit(EXIT_FAILURE);
+        }
+
+        if (quirks_given && quirks != movie.quirks) {
+            printf("Movie %s was recorded with quirk profile %s\n", replay, quirk_profile_name(movie.quirks));
+            exit(EXIT_FAILURE);
+        }
+
+        instructions_per_second = movie.instructions_per_second;
+        quirks = movie.quirks;
+
+        if (!seeded) {
+            seed = movie.seed;
+            seeded = true;
+        }
+
+        if (!limit_given) {
+            frame_limit = movie.frame_count;
+        }
+    }
+
+    chip8_object chip8 = {0};
+
+    bool chip8_initialized = rom
+        ? load_chip8(&chip8, rom->data, rom->size, rom->name)
+        : init_chip8(&chip8, rom_name);
+
+    if (!chip8_initialized) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (replay && chip8.rom_hash != movie.rom_hash) {
+        printf("Movie %s was recorded with a different rom\n", replay);
+        exit(EXIT_FAILURE);
+    }
+
+    chip8.quirks = quirks;
+
+    if (load_state && !load_snapshot_file(&chip8, load_state)) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (seeded) {
+        seed_chip8(&chip8, (uint32_t)seed);
+    }
+
+    static engine_object engine;
+    bool engine_initialized = init_engine(&engine, engine_kind);
+
+    if (!engine_initialized) {
+        exit(EXIT_FAILURE);
+    }
+
+    static debugger_object debugger;
+
+    if (debug) {
+        init_debugger(&debugger);
+        debugger.reason = DEBUG_STEP;
+        engine.debugger = &debugger;
+    }
+
+#ifdef CHIP8_PROFILE
+    static profile_object profile;
+    chip8.profile = &profile;
+#endif
+
+#ifdef CHIP8_TRACE
+    static trace_object trace;
+
+    if (trace_path) {
+        if (!start_trace(&trace, trace_path, &chip8)) {
+            exit(EXIT_FAILURE);
+        }
+
+        chip8.trace = &trace;
+    }
+#endif
+
+    chip8_object reference = chip8;
+    reference.stack_pointer = reference.stack + (chip8.stack_pointer - chip8.stack);
+#ifdef CHIP8_PROFILE
+    reference.profile = NULL;
+#endif
+#ifdef CHIP8_TRACE
+    reference.trace = NULL;
+#endif
+
+    const interpreter_function interpret_reference = select_interpreter(reference.quirks);
+    uint64_t cycles = 0;
+    uint64_t frames = 0;
+    size_t cursor = 0;
+    instruction_rate_object rate = {.instructions_per_second = instructions_per_second};
+    bool running = !debug || debug_prompt(&chip8, &debugger);
+
+    while (running && (frame_limit > 0 ? frames < frame_limit : cycles < instruction_limit)) {
+        cursor = apply_input_script(&movie.script, cursor, (uint32_t)frames, chip8.keypad);
+        memcpy(reference.keypad, chip8.keypad, sizeof reference.keypad);
+
+        const uint32_t instructions_per_frame = frame_instructions(&rate);
+        uint32_t batch = instructions_per_frame;
+
+        if (frame_limit == 0 && instruction_limit - cycles < batch) {
+            batch = (uint32_t)(instruction_limit - cycles);
+        }
+
+        if (debug) {
+            running = run_debugged(&engine, &chip8, &debugger, batch);
+        } else {
+            run_engine(&engine, &chip8, batch);
+        }
+
+        if (!running) {
+            break;
+        }
+
+        cycles += batch;
+
+        if (compare) {
+            for (uint32_t index = 0; index < batch; index++) {
+                interpret_reference(&reference);
+            }
+
+            if (!compare_chip8(&chip8, &reference)) {
+                printf("State diverged from the switch interpreter after %llu cycles\n", (unsigned long long)cycles);
+                dump_state(&chip8, cycles, frames);
+                printf("Reference:\n");
+                dump_state(&reference, cycles, frames);
+#ifdef CHIP8_TRACE
+                if (chip8.trace) {
+                    finish_trace(&trace);
+                }
+#endif
+                destroy_engine(&engine);
+                free_input_script(&movie.script);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if (batch == instructions_per_frame) {
+            tick_timers(&chip8);
+            tick_timers(&reference);
+            frames++;
+        }
+    }
+
+    dump_state(&chip8, cycles, frames);
+#ifdef CHIP8_PROFILE
+    print_profile_report(&profile, &chip8, stderr);
+#endif
+#ifdef CHIP8_TRACE
+    if (chip8.trace && !finish_trace(&trace)) {
+        exit(EXIT_FAILURE);
+    }
+#endif
+    destroy_engine(&engine);
+    free_input_script(&movie.script);
+    close_rom_library(&library);
+
+    if (save_state && !save_snapshot_file(&chip8, save_state)) {
+        exit(EXIT_FAILURE);
+    }
+
+    exit(EXIT_SUCCESS);
+}
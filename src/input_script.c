@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "input_script.h"
+
+#define MOVIE_VERSION 3
+
+static const uint8_t movie_magic[4] = {'C', '8', 'M', 'V'};
+
+bool append_input_event(input_script_object *script, uint32_t frame, uint8_t key, bool pressed)
+{
+    if (script->count == script->capacity) {
+        const size_t capacity = script->capacity ? script->capacity * 2 : 64;
+        input_event_object *events = realloc(script->events, capacity * sizeof *events);
+
+        if (!events) {
+            fprintf(stderr, "Could not grow input script\n");
+            return false;
+        }
+
+        script->events = events;
+        script->capacity = capacity;
+    }
+
+    script->events[script->count++] = (input_event_object){
+        .frame = frame,
+        .key = key,
+        .pressed = pressed,
+    };
+    return true;
+}
+
+bool load_input_script(input_script_object *script, const char *path)
+{
+    *script = (input_script_object){0};
+
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Input script %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    char line[128];
+    uint32_t line_number = 0;
+
+    while (fgets(line, sizeof line, file)) {
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        unsigned long frame = 0;
+        unsigned int key = 0;
+        char action[8] = {0};
+        const int fields = sscanf(line, "%lu %x %7s", &frame, &key, action);
+
+        if (fields <= 0) {
+            continue;
+        }
+
+        const bool pressed = strcmp(action, "down") == 0;
+
+        if (fields != 3 || key > 0xF || (!pressed && strcmp(action, "up") != 0)) {
+            fprintf(stderr, "Invalid input script line %u in %s\n", line_number, path);
+            fclose(file);
+            free_input_script(script);
+            return false;
+        }
+
+        if (script->count > 0 && frame < script->events[script->count - 1].frame) {
+            fprintf(stderr, "Input script %s is not sorted by frame (line %u)\n", path, line_number);
+            fclose(file);
+            free_input_script(script);
+            return false;
+        }
+
+        if (!append_input_event(script, (uint32_t)frame, (uint8_t)key, pressed)) {
+            fclose(file);
+            free_input_script(script);
+            return false;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+void free_input_script(input_script_object *script)
+{
+    free(script->events);
+    *script = (input_script_object){0};
+}
+
+size_t apply_input_script(const input_script_object *script, size_t cursor, uint32_t frame, bool keypad[16])
+{
+    while (cursor < script->count && script->events[cursor].frame <= frame) {
+        keypad[script->events[cursor].key] = script->events[cursor].pressed;
+        cursor++;
+    }
+
+    return cursor;
+}
+
+bool record_keypad_changes(input_script_object *script, uint32_t frame, bool previous[16], const bool keypad[16])
+{
+    for (uint8_t key = 0; key < 16; key++) {
+        if (keypad[key] == previous[key]) {
+            continue;
+        }
+
+        if (!append_input_event(script, frame, key, keypad[key])) {
+            return false;
+        }
+
+        previous[key] = keypad[key];
+    }
+
+    return true;
+}
+
+static void write_u32(FILE *file, uint32_t value)
+{
+    const uint8_t bytes[4] = {value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24};
+    fwrite(bytes, sizeof bytes, 1, file);
+}
+
+static bool read_u32(FILE *file, uint32_t *value)
+{
+    uint8_t bytes[4];
+
+    if (fread(bytes, sizeof bytes, 1, file) != 1) {
+        return false;
+    }
+
+    *value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+static void write_u64(FILE *file, uint64_t value)
+{
+    write_u32(file, value & 0xFFFFFFFF);
+    write_u32(file, value >> 32);
+}
+
+static bool read_u64(FILE *file, uint64_t *value)
+{
+    uint32_t low = 0;
+    uint32_t high = 0;
+
+    if (!read_u32(file, &low) || !read_u32(file, &high)) {
+        return false;
+    }
+
+    *value = low | ((uint64_t)high << 32);
+    return true;
+}
+
+bool save_movie(const movie_object *movie, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open movie file %s\n", path);
+        return false;
+    }
+
+    fwrite(movie_magic, sizeof movie_magic, 1, file);
+    fputc(MOVIE_VERSION, file);
+    write_u32(file, movie->seed);
+    write_u32(file, movie->instructions_per_second);
+    write_u32(file, movie->frame_count);
+    fputc(movie->quirks, file);
+    write_u64(file, movie->rom_hash);
+    write_u32(file, (uint32_t)movie->script.count);
+
+    uint32_t last_frame = 0;
+
+    for (size_t index = 0; index < movie->script.count; index++) {
+        const input_event_object *event = &movie->script.events[index];
+        uint32_t delta = event->frame - last_frame;
+
+        while (delta >= 0x80) {
+            fputc((delta & 0x7F) | 0x80, file);
+            delta >>= 7;
+        }
+
+        fputc(delta, file);
+        fputc(event->key | (event->pressed << 4), file);
+        last_frame = event->frame;
+    }
+
+    const bool write_success = !ferror(file);
+    fclose(file);
+
+    if (!write_success) {
+        fprintf(stderr, "Could not write movie file %s\n", path);
+    }
+
+    return write_success;
+}
+
+bool load_movie(movie_object *movie, const char *path)
+{
+    *movie = (movie_object){0};
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Movie file %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    uint8_t magic[sizeof movie_magic];
+    const bool header_valid = fread(magic, sizeof magic, 1, file) == 1
+        && memcmp(magic, movie_magic, sizeof magic) == 0
+        && fgetc(file) == MOVIE_VERSION;
+
+    if (!header_valid) {
+        fprintf(stderr, "Movie file %s has an invalid header or unsupported version\n", path);
+        fclose(file);
+        return false;
+    }
+
+    uint32_t event_count = 0;
+    bool read_success = read_u32(file, &movie->seed)
+        && read_u32(file, &movie->instructions_per_second)
+        && read_u32(file, &movie->frame_count);
+
+    const int quirks = fgetc(file);
+    read_success = read_success && quirks != EOF && quirks < QUIRKS_COUNT
+        && read_u64(file, &movie->rom_hash)
+        && read_u32(file, &event_count);
+    movie->quirks = (quirk_profile)quirks;
+
+    uint32_t frame = 0;
+
+    for (uint32_t index = 0; read_success && index < event_count; index++) {
+        uint32_t delta = 0;
+        int byte = 0;
+
+        for (uint8_t shift = 0; shift < 32; shift += 7) {
+            byte = fgetc(file);
+
+            if (byte == EOF) {
+                break;
+            }
+
+            delta |= (uint32_t)(byte & 0x7F) << shift;
+
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+
+        const int key = fgetc(file);
+
+        if (byte == EOF || key == EOF) {
+            read_success = false;
+            break;
+        }
+
+        frame += delta;
+        read_success = append_input_event(&movie->script, frame, key & 0x0F, (key >> 4) & 1);
+    }
+
+    fclose(file);
+
+    if (!read_success) {
+        fprintf(stderr, "Movie file %s is truncated or corrupt\n", path);
+        free_input_script(&movie->script);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,370 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "instance_pool.h"
+
+static bool private_page(const compact_chip8_object *instance, uint32_t page)
+{
+    return (instance->private_pages[page / 64] >> (page % 64)) & 1;
+}
+
+static uint32_t page_rank(const compact_chip8_object *instance, uint32_t page)
+{
+    uint32_t rank = 0;
+
+    for (uint32_t word = 0; word < page / 64; word++) {
+        rank += __builtin_popcountll(instance->private_pages[word]);
+    }
+
+    return rank + __builtin_popcountll(instance->private_pages[page / 64] & ((1ULL << (page % 64)) - 1));
+}
+
+static uint32_t page_count(const compact_chip8_object *instance)
+{
+    uint32_t count = 0;
+
+    for (uint32_t word = 0; word < POOL_PAGE_WORDS; word++) {
+        count += __builtin_popcountll(instance->private_pages[word]);
+    }
+
+    return count;
+}
+
+static bool insert_page(compact_chip8_object *instance, uint32_t page, const uint8_t *data)
+{
+    const uint32_t count = page_count(instance);
+    const uint32_t rank = page_rank(instance, page);
+    uint8_t (*pages)[POOL_PAGE_SIZE] = realloc(instance->pages, (count + 1) * sizeof *pages);
+
+    if (!pages) {
+        fprintf(stderr, "Could not allocate private page for instance\n");
+        return false;
+    }
+
+    memmove(&pages[rank + 1], &pages[rank], (count - rank) * sizeof *pages);
+    memcpy(pages[rank], data, sizeof *pages);
+    instance->pages = pages;
+    instance->private_pages[page / 64] |= 1ULL << (page % 64);
+    return true;
+}
+
+static void remove_page(compact_chip8_object *instance, uint32_t page)
+{
+    const uint32_t count = page_count(instance);
+    const uint32_t rank = page_rank(instance, page);
+
+    memmove(&instance->pages[rank], &instance->pages[rank + 1], (count - rank - 1) * sizeof *instance->pages);
+    instance->private_pages[page / 64] &= ~(1ULL << (page % 64));
+
+    if (count == 1) {
+        free(instance->pages);
+        instance->pages = NULL;
+    }
+}
+
+static bool lores_display(const chip8_object *chip8)
+{
+    uint64_t outside = 0;
+
+    if (chip8->hires) {
+        return false;
+    }
+
+    for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+        for (uint8_t word = 0; word < DISPLAY_WORDS; word++) {
+            outside |= chip8->display[1][y][word];
+
+            if (y >= WINDOW_HEIGHT || word > 0) {
+                outside |= chip8->display[0][y][word];
+            }
+        }
+    }
+
+    return outside == 0;
+}
+
+static bool store_state(compact_chip8_object *instance, const chip8_object *chip8)
+{
+    if (lores_display(chip8)) {
+        free(instance->display);
+        instance->display = NULL;
+
+        for (uint8_t y = 0; y < WINDOW_HEIGHT; y++) {
+            instance->lores[y] = chip8->display[0][y][0];
+        }
+    } else {
+        if (!instance->display) {
+            instance->display = malloc(sizeof chip8->display);
+
+            if (!instance->display) {
+                fprintf(stderr, "Could not allocate display for instance\n");
+                return false;
+            }
+        }
+
+        memcpy(instance->display, chip8->display, sizeof chip8->display);
+    }
+
+    instance->keypad = 0;
+
+    for (uint8_t key = 0; key < 16; key++) {
+        instance->keypad |= (uint16_t)chip8->keypad[key] << key;
+    }
+
+    memcpy(instance->stack, chip8->stack, sizeof instance->stack);
+    memcpy(instance->V, chip8->V, sizeof instance->V);
+    memcpy(instance->rpl, chip8->rpl, sizeof instance->rpl);
+    instance->dirty_rows = chip8->dirty_rows;
+    instance->rng_state = chip8->rng_state;
+    instance->I = chip8->I;
+    instance->program_counter = chip8->program_counter;
+    instance->stack_depth = (uint8_t)(chip8->stack_pointer - chip8->stack);
+    instance->delay_timer = chip8->delay_timer;
+    instance->sound_timer = chip8->sound_timer;
+    instance->pending_key = chip8->pending_key;
+    instance->planes = chip8->planes;
+    instance->state = (uint8_t)chip8->state;
+    instance->hires = chip8->hires;
+    instance->key_pending = chip8->key_pending;
+    return true;
+}
+
+static void load_state(chip8_object *chip8, const compact_chip8_object *instance)
+{
+    if (instance->display) {
+        memcpy(chip8->display, instance->display, sizeof chip8->display);
+    } else {
+        memset(chip8->display, 0, sizeof chip8->display);
+
+        for (uint8_t y = 0; y < WINDOW_HEIGHT; y++) {
+            chip8->display[0][y][0] = instance->lores[y];
+        }
+    }
+
+    for (uint8_t key = 0; key < 16; key++) {
+        chip8->keypad[key] = (instance->keypad >> key) & 1;
+    }
+
+    memcpy(chip8->stack, instance->stack, sizeof instance->stack);
+    memcpy(chip8->V, instance->V, sizeof instance->V);
+    memcpy(chip8->rpl, instance->rpl, sizeof instance->rpl);
+    chip8->dirty_rows = instance->dirty_rows;
+    chip8->rng_state = instance->rng_state;
+    chip8->I = instance->I;
+    chip8->program_counter = instance->program_counter;
+    chip8->stack_pointer = chip8->stack + instance->stack_depth;
+    chip8->delay_timer = instance->delay_timer;
+    chip8->sound_timer = instance->sound_timer;
+    chip8->pending_key = instance->pending_key;
+    chip8->planes = instance->planes;
+    chip8->state = (emulator_state)instance->state;
+    chip8->hires = instance->hires;
+    chip8->key_pending = instance->key_pending;
+}
+
+void release_compact_chip8(compact_chip8_object *instance)
+{
+    free(instance->pages);
+    free(instance->display);
+    instance->pages = NULL;
+    instance->display = NULL;
+}
+
+bool init_instance_pool(instance_pool_object *pool, const chip8_object *prototype, uint32_t count)
+{
+    if (count == 0) {
+        fprintf(stderr, "Instance pools need at least one instance\n");
+        return false;
+    }
+
+    pool->instances = calloc(count, sizeof *pool->instances);
+
+    if (!pool->instances) {
+        fprintf(stderr, "Could not allocate %u pooled instances\n", count);
+        return false;
+    }
+
+    memcpy(pool->image, prototype->ram, sizeof pool->image);
+    pool->count = count;
+    pool->quirks = prototype->quirks;
+    pool->rom_name = prototype->rom_name;
+
+    for (uint32_t index = 0; index < count; index++) {
+        if (!store_state(&pool->instances[index], prototype)) {
+            destroy_instance_pool(pool);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void destroy_instance_pool(instance_pool_object *pool)
+{
+    for (uint32_t index = 0; index < pool->count; index++) {
+        release_compact_chip8(&pool->instances[index]);
+    }
+
+    free(pool->instances);
+    pool->instances = NULL;
+    pool->count = 0;
+}
+
+void init_pool_worker(const instance_pool_object *pool, chip8_object *chip8)
+{
+    memcpy(chip8->ram, pool->image, sizeof chip8->ram);
+    clear_ram_dirty(chip8);
+    chip8->quirks = pool->quirks;
+    chip8->rom_name = pool->rom_name;
+    chip8->restore_count = 0;
+}
+
+void load_compact_chip8(const instance_pool_object *pool, const compact_chip8_object *instance, chip8_object *chip8)
+{
+    uint32_t rank = 0;
+
+    for (uint32_t word = 0; word < RAM_DIRTY_WORDS; word++) {
+        for (uint64_t dirty = chip8->ram_dirty[word]; dirty; dirty &= dirty - 1) {
+            const uint32_t offset = (word * 64 + __builtin_ctzll(dirty)) * RAM_BLOCK_SIZE;
+
+            memcpy(&chip8->ram[offset], &pool->image[offset], RAM_BLOCK_SIZE);
+        }
+    }
+
+    clear_ram_dirty(chip8);
+
+    for (uint32_t word = 0; word < POOL_PAGE_WORDS; word++) {
+        for (uint64_t pages = instance->private_pages[word]; pages; pages &= pages - 1) {
+            const uint32_t page = word * 64 + __builtin_ctzll(pages);
+
+            memcpy(&chip8->ram[page * POOL_PAGE_SIZE], instance->pages[rank++], POOL_PAGE_SIZE);
+            mark_ram_dirty(chip8, page * POOL_PAGE_SIZE, page * POOL_PAGE_SIZE + POOL_PAGE_SIZE - 1);
+        }
+    }
+
+    load_state(chip8, instance);
+}
+
+bool store_compact_chip8(const instance_pool_object *pool, compact_chip8_object *instance, const chip8_object *chip8)
+{
+    uint32_t previous_page = POOL_PAGES;
+
+    for (uint32_t word = 0; word < RAM_DIRTY_WORDS; word++) {
+        for (uint64_t dirty = chip8->ram_dirty[word]; dirty; dirty &= dirty - 1) {
+            const uint32_t page = (word * 64 + __builtin_ctzll(dirty)) / POOL_PAGE_BLOCKS;
+
+            if (page == previous_page) {
+                continue;
+            }
+
+            previous_page = page;
+            const uint8_t *data = &chip8->ram[page * POOL_PAGE_SIZE];
+            const uint8_t *image = &pool->image[page * POOL_PAGE_SIZE];
+
+            if (!private_page(instance, page)) {
+                if (memcmp(data, image, POOL_PAGE_SIZE) != 0 && !insert_page(instance, page, data)) {
+                    return false;
+                }
+                continue;
+            }
+
+            uint8_t *stored = instance->pages[page_rank(instance, page)];
+
+            if (memcmp(data, stored, POOL_PAGE_SIZE) == 0) {
+                continue;
+            }
+
+            if (memcmp(data, image, POOL_PAGE_SIZE) == 0) {
+                remove_page(instance, page);
+            } else {
+                memcpy(stored, data, POOL_PAGE_SIZE);
+            }
+        }
+    }
+
+    return store_state(instance, chip8);
+}
+
+static uint64_t mix_hash(uint64_t hash, uint64_t value)
+{
+    hash ^= value;
+    hash *= 0x100000001B3;
+    return hash ^ (hash >> 29);
+}
+
+uint64_t hash_compact_chip8(const compact_chip8_object *instance)
+{
+    const uint32_t count = page_count(instance);
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (uint32_t word = 0; word < POOL_PAGE_WORDS; word++) {
+        hash = mix_hash(hash, instance->private_pages[word]);
+    }
+
+    for (uint32_t rank = 0; rank < count; rank++) {
+        for (uint32_t offset = 0; offset < POOL_PAGE_SIZE; offset += sizeof(uint64_t)) {
+            uint64_t value;
+
+            memcpy(&value, &instance->pages[rank][offset], sizeof value);
+            hash = mix_hash(hash, value);
+        }
+    }
+
+    if (instance->display) {
+        const uint64_t *words = &instance->display[0][0][0];
+
+        for (uint32_t word = 0; word < DISPLAY_PLANES * DISPLAY_HEIGHT * DISPLAY_WORDS; word++) {
+            hash = mix_hash(hash, words[word]);
+        }
+    } else {
+        for (uint8_t y = 0; y < WINDOW_HEIGHT; y++) {
+            hash = mix_hash(hash, instance->lores[y]);
+        }
+    }
+
+    for (uint8_t depth = 0; depth < instance->stack_depth; depth++) {
+        hash = mix_hash(hash, instance->stack[depth]);
+    }
+
+    for (uint8_t reg = 0; reg < 16; reg += 8) {
+        uint64_t V;
+        uint64_t rpl;
+
+        memcpy(&V, &instance->V[reg], sizeof V);
+        memcpy(&rpl, &instance->rpl[reg], sizeof rpl);
+        hash = mix_hash(hash, V);
+        hash = mix_hash(hash, rpl);
+    }
+
+    hash = mix_hash(hash, ((uint64_t)instance->I << 48) | ((uint64_t)instance->program_counter << 32) | instance->rng_state);
+    hash = mix_hash(hash, ((uint64_t)instance->keypad << 48) | ((uint64_t)instance->stack_depth << 40)
+        | ((uint64_t)instance->delay_timer << 32) | ((uint64_t)instance->sound_timer << 24)
+        | ((uint64_t)instance->pending_key << 16) | ((uint64_t)instance->key_pending << 10)
+        | ((uint64_t)instance->hires << 9) | ((uint64_t)instance->planes << 1));
+    return hash;
+}
+
+void checkout_instance(const instance_pool_object *pool, uint32_t index, chip8_object *chip8)
+{
+    load_compact_chip8(pool, &pool->instances[index], chip8);
+}
+
+bool checkin_instance(instance_pool_object *pool, uint32_t index, chip8_object *chip8)
+{
+    return store_compact_chip8(pool, &pool->instances[index], chip8);
+}
+
+size_t instance_pool_memory(const instance_pool_object *pool)
+{
+    size_t bytes = sizeof *pool + pool->count * sizeof *pool->instances;
+
+    for (uint32_t index = 0; index < pool->count; index++) {
+        const compact_chip8_object *instance = &pool->instances[index];
+
+        bytes += page_count(instance) * POOL_PAGE_SIZE;
+        bytes += instance->display ? sizeof *instance->display * DISPLAY_PLANES : 0;
+    }
+
+    return bytes;
+}
@@ -0,0 +1,410 @@
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "jit.h"
+
+#define ADDRESS_MASK (MEMORY_SIZE - 1)
+#define ARENA_SIZE (1 << 20)
+#define UNTRANSLATED UINT32_MAX
+#define MAX_BLOCK_LENGTH 255
+#define MAX_INSTRUCTION_BYTES 64
+#define MAX_BLOCK_BYTES (MAX_BLOCK_LENGTH * MAX_INSTRUCTION_BYTES + 16)
+
+#define V_OFFSET(index) ((uint32_t)(offsetof(chip8_object, V) + (index)))
+#define I_OFFSET ((uint32_t)offsetof(chip8_object, I))
+#define PC_OFFSET ((uint32_t)offsetof(chip8_object, program_counter))
+#define DELAY_OFFSET ((uint32_t)offsetof(chip8_object, delay_timer))
+#define SOUND_OFFSET ((uint32_t)offsetof(chip8_object, sound_timer))
+
+enum {
+    REG_AL = 0,
+    REG_CL = 1
+};
+
+typedef uint32_t (*block_function)(chip8_object *chip8, uint32_t budget);
+
+static uint16_t opcode_at(const chip8_object *chip8, uint16_t address)
+{
+    return (chip8->ram[address & ADDRESS_MASK] << 8) | chip8->ram[(address + 1) & ADDRESS_MASK];
+}
+
+#if defined(__x86_64__)
+
+static void emit_byte(uint8_t **code, uint8_t byte)
+{
+    *(*code)++ = byte;
+}
+
+static void emit_word(uint8_t **code, uint16_t word)
+{
+    emit_byte(code, word & 0xFF);
+    emit_byte(code, word >> 8);
+}
+
+static void emit_dword(uint8_t **code, uint32_t dword)
+{
+    emit_word(code, dword & 0xFFFF);
+    emit_word(code, dword >> 16);
+}
+
+static void emit_rdi_operand(uint8_t **code, uint8_t reg, uint32_t offset)
+{
+    emit_byte(code, 0x80 | (reg << 3) | 0x07);
+    emit_dword(code, offset);
+}
+
+static void emit_load_byte(uint8_t **code, uint8_t reg, uint32_t offset)
+{
+    emit_byte(code, 0x8A);
+    emit_rdi_operand(code, reg, offset);
+}
+
+static void emit_store_byte(uint8_t **code, uint8_t reg, uint32_t offset)
+{
+    emit_byte(code, 0x88);
+    emit_rdi_operand(code, reg, offset);
+}
+
+static void emit_store_imm8(uint8_t **code, uint32_t offset, uint8_t value)
+{
+    emit_byte(code, 0xC6);
+    emit_rdi_operand(code, 0, offset);
+    emit_byte(code, value);
+}
+
+static void emit_store_imm16(uint8_t **code, uint32_t offset, uint16_t value)
+{
+    emit_byte(code, 0x66);
+    emit_byte(code, 0xC7);
+    emit_rdi_operand(code, 0, offset);
+    emit_word(code, value);
+}
+
+static void emit_alu_al(uint8_t **code, uint8_t opcode, uint32_t offset)
+{
+    emit_byte(code, opcode);
+    emit_rdi_operand(code, REG_AL, offset);
+}
+
+static void emit_flag_result(uint8_t **code, uint8_t setcc, uint8_t X)
+{
+    emit_byte(code, 0x0F);
+    emit_byte(code, setcc);
+    emit_byte(code, 0xC1);
+    emit_store_byte(code, REG_AL, V_OFFSET(X));
+    emit_store_byte(code, REG_CL, V_OFFSET(0xF));
+}
+
+static void emit_load_vx_zero_extended(uint8_t **code, uint8_t X)
+{
+    emit_byte(code, 0x0F);
+    emit_byte(code, 0xB6);
+    emit_rdi_operand(code, REG_AL, V_OFFSET(X));
+}
+
+static void emit_exit(uint8_t **code, uint16_t address, uint8_t executed)
+{
+    emit_store_imm16(code, PC_OFFSET, address);
+    emit_byte(code, 0xB8);
+    emit_dword(code, executed);
+    emit_byte(code, 0xC3);
+}
+
+static void emit_budget_check(uint8_t **code, uint16_t address, uint8_t executed)
+{
+    emit_byte(code, 0xFF);
+    emit_byte(code, 0xCE);
+    emit_byte(code, 0x75);
+
+    uint8_t *jump = (*code)++;
+    emit_exit(code, address, executed);
+    *jump = (uint8_t)(*code - jump - 1);
+}
+
+static bool emit_instruction(uint8_t **code, uint16_t opcode, uint32_t quirks)
+{
+    const uint8_t NN = opcode & 0x0FF;
+    const uint8_t X = (opcode >> 8) & 0x0F;
+    const uint8_t Y = (opcode >> 4) & 0x0F;
+
+    switch ((opcode >> 12) & 0x0F)
+    {
+        case 0x06:
+            emit_store_imm8(code, V_OFFSET(X), NN);
+            return true;
+
+        case 0x07:
+            emit_byte(code, 0x80);
+            emit_rdi_operand(code, 0, V_OFFSET(X));
+            emit_byte(code, NN);
+            return true;
+
+        case 0x08:
+            switch (opcode & 0x0F)
+            {
+                case 0:
+                    emit_load_byte(code, REG_AL, V_OFFSET(Y));
+                    emit_store_byte(code, REG_AL, V_OFFSET(X));
+                    return true;
+
+                case 1:
+                case 2:
+                case 3: {
+                    const uint8_t alu[] = {0x0A, 0x22, 0x32};
+
+                    emit_load_byte(code, REG_AL, V_OFFSET(X));
+                    emit_alu_al(code, alu[(opcode & 0x0F) - 1], V_OFFSET(Y));
+                    emit_store_byte(code, REG_AL, V_OFFSET(X));
+                    if (quirks & QUIRK_VF_RESET) {
+                        emit_store_imm8(code, V_OFFSET(0xF), 0);
+                    }
+                    return true;
+                }
+
+                case 4:
+                    emit_load_byte(code, REG_AL, V_OFFSET(X));
+                    emit_alu_al(code, 0x02, V_OFFSET(Y));
+                    emit_flag_result(code, 0x92, X);
+                    return true;
+
+                case 5:
+                    emit_load_byte(code, REG_AL, V_OFFSET(X));
+                    emit_alu_al(code, 0x2A, V_OFFSET(Y));
+                    emit_flag_result(code, 0x93, X);
+                    return true;
+
+                case 6:
+                    emit_load_byte(code, REG_AL, V_OFFSET((quirks & QUIRK_SHIFT_VX) ? X : Y));
+                    emit_byte(code, 0xD0);
+                    emit_byte(code, 0xE8);
+                    emit_flag_result(code, 0x92, X);
+                    return true;
+
+                case 7:
+                    emit_load_byte(code, REG_AL, V_OFFSET(Y));
+                    emit_alu_al(code, 0x2A, V_OFFSET(X));
+                    emit_flag_result(code, 0x93, X);
+                    return true;
+
+                case 0xE:
+                    emit_load_byte(code, REG_AL, V_OFFSET((quirks & QUIRK_SHIFT_VX) ? X : Y));
+                    emit_byte(code, 0xD0);
+                    emit_byte(code, 0xE0);
+                    emit_flag_result(code, 0x92, X);
+                    return true;
+
+                default:
+                    return false;
+            }
+
+        case 0x0A:
+            emit_store_imm16(code, I_OFFSET, opcode & 0x0FFF);
+            return true;
+
+        case 0x0F:
+            switch (NN)
+            {
+                case 0x07:
+                    emit_load_byte(code, REG_AL, DELAY_OFFSET);
+                    emit_store_byte(code, REG_AL, V_OFFSET(X));
+                    return true;
+
+                case 0x15:
+                    emit_load_byte(code, REG_AL, V_OFFSET(X));
+                    emit_store_byte(code, REG_AL, DELAY_OFFSET);
+                    return true;
+
+                case 0x18:
+                    emit_load_byte(code, REG_AL, V_OFFSET(X));
+                    emit_store_byte(code, REG_AL, SOUND_OFFSET);
+                    return true;
+
+                case 0x1E:
+                    emit_load_vx_zero_extended(code, X);
+                    emit_byte(code, 0x66);
+                    emit_byte(code, 0x01);
+                    emit_rdi_operand(code, REG_AL, I_OFFSET);
+                    return true;
+
+                case 0x29:
+                    emit_load_vx_zero_extended(code, X);
+                    emit_byte(code, 0x8D);
+                    emit_byte(code, 0x04);
+                    emit_byte(code, 0x80);
+                    emit_byte(code, 0x66);
+                    emit_byte(code, 0x89);
+                    emit_rdi_operand(code, REG_AL, I_OFFSET);
+                    return true;
+
+                default:
+                    return false;
+            }
+
+        default:
+            return false;
+    }
+}
+
+static void translate_block(jit_object *jit, const chip8_object *chip8, uint16_t pc)
+{
+    uint8_t buffer[MAX_BLOCK_BYTES];
+    uint8_t *code = buffer;
+    uint32_t address = pc;
+    uint8_t length = 0;
+    const uint32_t quirks = quirk_flags(chip8->quirks);
+
+    while (length < MAX_BLOCK_LENGTH && address < MEMORY_SIZE - 1) {
+        uint8_t *const instruction_start = code;
+
+        if (length > 0) {
+            emit_budget_check(&code, address, length);
+        }
+
+        if (!emit_instruction(&code, opcode_at(chip8, address), quirks)) {
+            code = instruction_start;
+            break;
+        }
+
+        address += 2;
+        length++;
+    }
+
+    jit->block_offset[pc] = 0;
+    jit->block_length[pc] = length;
+
+    if (length == 0) {
+        return;
+    }
+
+    emit_exit(&code, address, length);
+
+    const size_t size = (size_t)(code - buffer);
+
+    if (jit->arena_size - jit->arena_used < size) {
+        reset_jit(jit);
+        jit->block_length[pc] = length;
+    }
+
+    mprotect(jit->arena, jit->arena_size, PROT_READ | PROT_WRITE);
+    memcpy(jit->arena + jit->arena_used, buffer, size);
+    mprotect(jit->arena, jit->arena_size, PROT_READ | PROT_EXEC);
+
+    jit->block_offset[pc] = (uint32_t)jit->arena_used;
+    jit->arena_used = (jit->arena_used + size + 15) & ~(size_t)15;
+
+    memset(&jit->code_map[pc], true, address - pc);
+}
+
+bool init_jit(jit_object *jit)
+{
+    jit->arena_size = ARENA_SIZE;
+    jit->arena = mmap(NULL, jit->arena_size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (jit->arena == MAP_FAILED) {
+        jit->arena = NULL;
+        fprintf(stderr, "Could not map JIT code arena\n");
+        return false;
+    }
+
+    jit->quirks = QUIRKS_VIP;
+    reset_jit(jit);
+    return true;
+}
+
+#else
+
+static void translate_block(jit_object *jit, const chip8_object *chip8, uint16_t pc)
+{
+    (void)chip8;
+
+    jit->block_offset[pc] = 0;
+    jit->block_length[pc] = 0;
+}
+
+bool init_jit(jit_object *jit)
+{
+    jit->arena = NULL;
+    jit->arena_size = 0;
+    fprintf(stderr, "The JIT engine is only available on x86-64\n");
+    return false;
+}
+
+#endif
+
+void destroy_jit(jit_object *jit)
+{
+    if (jit->arena) {
+        munmap(jit->arena, jit->arena_size);
+        jit->arena = NULL;
+    }
+}
+
+void reset_jit(jit_object *jit)
+{
+    jit->arena_used = 0;
+    memset(jit->block_offset, 0xFF, sizeof jit->block_offset);
+    memset(jit->block_length, 0, sizeof jit->block_length);
+    memset(jit->code_map, false, sizeof jit->code_map);
+}
+
+static void interpret_instruction(jit_object *jit, chip8_object *chip8)
+{
+    const uint16_t opcode = opcode_at(chip8, chip8->program_counter);
+    const uint16_t first = chip8->I;
+    const uint8_t X = (opcode >> 8) & 0x0F;
+    const uint8_t Y = (opcode >> 4) & 0x0F;
+    uint32_t last = first;
+
+    emulate_instruction(chip8);
+
+    if ((opcode & 0xF0FF) == 0xF033) {
+        last += 2;
+    } else if ((opcode & 0xF0FF) == 0xF055) {
+        last += X;
+    } else if ((opcode & 0xF00F) == 0x5002) {
+        last += X < Y ? Y - X : X - Y;
+    } else {
+        return;
+    }
+
+    for (uint32_t address = first; address <= last; address++) {
+        if (jit->code_map[address & ADDRESS_MASK]) {
+            reset_jit(jit);
+            return;
+        }
+    }
+}
+
+void run_jit(jit_object *jit, chip8_object *chip8, uint32_t count)
+{
+    uint32_t remaining = count;
+
+    if (jit->quirks != chip8->quirks) {
+        reset_jit(jit);
+        jit->quirks = chip8->quirks;
+    }
+
+    while (remaining > 0) {
+        const uint16_t pc = chip8->program_counter;
+
+        if (pc < MEMORY_SIZE - 1) {
+            if (jit->block_offset[pc] == UNTRANSLATED) {
+                translate_block(jit, chip8, pc);
+            }
+
+            if (jit->block_length[pc] > 0) {
+                const block_function block = (block_function)(void *)(jit->arena + jit->block_offset[pc]);
+
+                remaining -= block(chip8, remaining);
+                continue;
+            }
+        }
+
+        interpret_instruction(jit, chip8);
+        remaining--;
+    }
+}
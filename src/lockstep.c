@@ -0,0 +1,538 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lockstep.h"
+
+#if defined(__x86_64__)
+#define VECTOR_TARGETS __attribute__((target_clones("avx2", "default")))
+#else
+#define VECTOR_TARGETS
+#endif
+
+#define BYTE_LANES LOCKSTEP_VECTOR_SIZE
+#define WORD_LANES (LOCKSTEP_VECTOR_SIZE / 2)
+#define BLEND(old, new, mask) (((old) & ~(mask)) | ((new) & (mask)))
+
+typedef struct {
+    uint32_t count;
+    uint32_t uniform;
+    uint32_t most_spent;
+    uint32_t spent[LOCKSTEP_MAX_INSTANCES];
+    uint64_t active;
+} budget_object;
+
+typedef uint8_t byte_vector __attribute__((vector_size(LOCKSTEP_VECTOR_SIZE)));
+typedef uint16_t word_vector __attribute__((vector_size(LOCKSTEP_VECTOR_SIZE)));
+typedef uint8_t half_byte_vector __attribute__((vector_size(LOCKSTEP_VECTOR_SIZE / 2)));
+typedef uint64_t register_vector __attribute__((vector_size(16)));
+
+bool init_lockstep(lockstep_object *lockstep, const chip8_object *prototype, uint32_t count)
+{
+    if (count == 0 || count > LOCKSTEP_MAX_INSTANCES) {
+        fprintf(stderr, "Lockstep groups hold 1 to %d instances\n", LOCKSTEP_MAX_INSTANCES);
+        return false;
+    }
+
+    memset(lockstep, 0, sizeof *lockstep);
+    lockstep->instances = malloc(count * sizeof *lockstep->instances);
+
+    if (!lockstep->instances) {
+        fprintf(stderr, "Could not allocate %u lockstep instances\n", count);
+        return false;
+    }
+
+    lockstep->count = count;
+    lockstep->lanes = count == 64 ? UINT64_MAX : (1ULL << count) - 1;
+    lockstep->synced_lanes = lockstep->lanes;
+    lockstep->quirks = quirk_flags(prototype->quirks);
+    lockstep->interpret = select_interpreter(prototype->quirks);
+
+    for (uint32_t lane = 0; lane < count; lane++) {
+        chip8_object *chip8 = &lockstep->instances[lane];
+
+        *chip8 = *prototype;
+        chip8->stack_pointer = chip8->stack + (prototype->stack_pointer - prototype->stack);
+        clear_ram_dirty(chip8);
+
+        for (uint8_t reg = 0; reg < 16; reg++) {
+            lockstep->V[reg][lane] = prototype->V[reg];
+        }
+
+        lockstep->I[lane] = prototype->I;
+        lockstep->program_counter[lane] = prototype->program_counter;
+    }
+
+    return true;
+}
+
+void destroy_lockstep(lockstep_object *lockstep)
+{
+    free(lockstep->instances);
+    lockstep->instances = NULL;
+    lockstep->count = 0;
+    lockstep->lanes = 0;
+}
+
+static register_vector store_registers(lockstep_object *lockstep, uint32_t lane)
+{
+    chip8_object *chip8 = &lockstep->instances[lane];
+    register_vector registers;
+
+    if ((lockstep->synced_lanes >> lane) & 1) {
+        memcpy(&registers, chip8->V, sizeof registers);
+        return registers;
+    }
+
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    for (uint32_t reg = 0; reg < 8; reg++) {
+        low |= (uint64_t)lockstep->V[reg][lane] << (reg * 8);
+        high |= (uint64_t)lockstep->V[reg + 8][lane] << (reg * 8);
+    }
+
+    registers = (register_vector){low, high};
+    memcpy(chip8->V, &registers, sizeof registers);
+    chip8->I = lockstep->I[lane];
+    lockstep->synced_lanes |= 1ULL << lane;
+
+    return registers;
+}
+
+static void load_registers(lockstep_object *lockstep, uint32_t lane, register_vector stored)
+{
+    const chip8_object *chip8 = &lockstep->instances[lane];
+    register_vector registers;
+
+    memcpy(&registers, chip8->V, sizeof registers);
+
+    for (uint32_t half = 0; half < 2; half++) {
+        uint64_t changed = registers[half] ^ stored[half];
+
+        while (changed) {
+            const uint32_t byte = __builtin_ctzll(changed) / 8;
+
+            lockstep->V[half * 8 + byte][lane] = chip8->V[half * 8 + byte];
+            changed &= ~(0xFFULL << (byte * 8));
+        }
+    }
+
+    lockstep->I[lane] = chip8->I;
+}
+
+static bool vector_opcode(uint16_t opcode, uint32_t quirks)
+{
+    switch (opcode >> 12)
+    {
+        case 0x1:
+        case 0x6:
+        case 0x7:
+        case 0x8:
+        case 0xA:
+        case 0xB:
+            return true;
+
+        case 0x3:
+        case 0x4:
+        case 0x9:
+            return !(quirks & QUIRK_LONG_SKIP);
+
+        case 0x5:
+            return (opcode & 0x0F) == 0 && !(quirks & QUIRK_LONG_SKIP);
+
+        case 0xF:
+            return (opcode & 0xFF) == 0x1E;
+
+        default:
+            return false;
+    }
+}
+
+static uint64_t matching_lanes(const lockstep_object *lockstep, uint16_t program_counter)
+{
+    uint8_t equal[LOCKSTEP_MAX_INSTANCES];
+    uint64_t matching = 0;
+
+    for (uint32_t lane = 0; lane < LOCKSTEP_MAX_INSTANCES; lane++) {
+        equal[lane] = lockstep->program_counter[lane] == program_counter;
+    }
+
+    for (uint32_t lane = 0; lane < LOCKSTEP_MAX_INSTANCES; lane += 8) {
+        uint64_t bytes;
+
+        memcpy(&bytes, &equal[lane], sizeof bytes);
+        matching |= ((bytes * 0x0102040810204080ULL) >> 56) << lane;
+    }
+
+    return matching & lockstep->lanes;
+}
+
+static uint32_t lane_count(const lockstep_object *lockstep, uint64_t group)
+{
+    return group == lockstep->lanes ? lockstep->count : (uint32_t)__builtin_popcountll(group);
+}
+
+static uint64_t shared_code_lanes(const lockstep_object *lockstep, uint64_t group, uint16_t program_counter, uint16_t opcode)
+{
+    const uint16_t next = program_counter + 1;
+    const uint32_t block = program_counter / RAM_BLOCK_SIZE;
+    const uint32_t next_block = next / RAM_BLOCK_SIZE;
+
+    if (!((lockstep->code_dirty[block / 64] >> (block % 64)) & 1)
+        && !((lockstep->code_dirty[next_block / 64] >> (next_block % 64)) & 1)) {
+        return group;
+    }
+
+    for (uint64_t pending = group; pending; pending &= pending - 1) {
+        const uint32_t lane = __builtin_ctzll(pending);
+        const uint8_t *ram = lockstep->instances[lane].ram;
+
+        if (((ram[program_counter] << 8) | ram[next]) != opcode) {
+            group &= ~(1ULL << lane);
+        }
+    }
+
+    return group;
+}
+
+VECTOR_TARGETS
+static void execute_vector(lockstep_object *lockstep, uint64_t group, uint16_t program_counter, uint16_t opcode)
+{
+    const uint8_t X = (opcode >> 8) & 0x0F;
+    const uint8_t Y = (opcode >> 4) & 0x0F;
+    const uint8_t N = opcode & 0x0F;
+    const uint8_t NN = opcode & 0xFF;
+    const uint16_t NNN = opcode & 0x0FFF;
+    const uint32_t quirks = lockstep->quirks;
+    const uint32_t byte_chunks = (lockstep->count + BYTE_LANES - 1) / BYTE_LANES;
+    const uint32_t word_chunks = (lockstep->count + WORD_LANES - 1) / WORD_LANES;
+    uint8_t skip_lanes[LOCKSTEP_MAX_INSTANCES] __attribute__((aligned(LOCKSTEP_VECTOR_SIZE)));
+
+    if (group != lockstep->mask_group) {
+        for (uint32_t lane = 0; lane < LOCKSTEP_MAX_INSTANCES; lane++) {
+            lockstep->byte_mask[lane] = -(uint8_t)((group >> lane) & 1);
+            lockstep->word_mask[lane] = -(uint16_t)((group >> lane) & 1);
+        }
+
+        lockstep->mask_group = group;
+    }
+
+    const byte_vector *byte_mask = (const byte_vector *)lockstep->byte_mask;
+    const word_vector *word_mask = (const word_vector *)lockstep->word_mask;
+    byte_vector *vx = (byte_vector *)lockstep->V[X];
+    byte_vector *vy = (byte_vector *)lockstep->V[Y];
+    byte_vector *vf = (byte_vector *)lockstep->V[0xF];
+    byte_vector *skip = (byte_vector *)skip_lanes;
+    word_vector *index = (word_vector *)lockstep->I;
+    word_vector *pc = (word_vector *)lockstep->program_counter;
+    const uint16_t next = program_counter + 2;
+
+    switch (opcode >> 12)
+    {
+        case 0x1:
+            for (uint32_t chunk = 0; chunk < word_chunks; chunk++) {
+                pc[chunk] = BLEND(pc[chunk], (word_vector){0} + NNN, word_mask[chunk]);
+            }
+            return;
+
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+            for (uint32_t chunk = 0; chunk < byte_chunks; chunk++) {
+                const byte_vector compare = (opcode >> 12) <= 0x4 ? (byte_vector){0} + NN : vy[chunk];
+                const byte_vector equal = (byte_vector)(vx[chunk] == compare);
+
+                skip[chunk] = ((opcode >> 12) == 0x3 || (opcode >> 12) == 0x5) ? equal : ~equal;
+            }
+
+            for (uint32_t chunk = 0; chunk < word_chunks; chunk++) {
+                const word_vector taken = __builtin_convertvector(((const half_byte_vector *)skip_lanes)[chunk], word_vector) & 2;
+
+                pc[chunk] = BLEND(pc[chunk], next + taken, word_mask[chunk]);
+            }
+            return;
+
+        case 0x6:
+            for (uint32_t chunk = 0; chunk < byte_chunks; chunk++) {
+                vx[chunk] = BLEND(vx[chunk], (byte_vector){0} + NN, byte_mask[chunk]);
+            }
+            break;
+
+        case 0x7:
+            for (uint32_t chunk = 0; chunk < byte_chunks; chunk++) {
+                vx[chunk] = BLEND(vx[chunk], vx[chunk] + NN, byte_mask[chunk]);
+            }
+            break;
+
+        case 0x8: {
+            const bool writes_flag = N >= 0x4 ? (N <= 0x7 || N == 0xE) : (N != 0x0 && (quirks & QUIRK_VF_RESET));
+
+            for (uint32_t chunk = 0; chunk < byte_chunks; chunk++) {
+                const byte_vector x = vx[chunk];
+                const byte_vector y = vy[chunk];
+                const byte_vector source = (quirks & QUIRK_SHIFT_VX) ? x : y;
+                byte_vector result = x;
+                byte_vector flag = {0};
+
+                switch (N)
+                {
+                    case 0x0: result = y; break;
+                    case 0x1: result = x | y; break;
+                    case 0x2: result = x & y; break;
+                    case 0x3: result = x ^ y; break;
+                    case 0x4: result = x + y; flag = (byte_vector)(result < x) & 1; break;
+                    case 0x5: result = x - y; flag = (byte_vector)(y <= x) & 1; break;
+                    case 0x6: result = source >> 1; flag = source & 1; break;
+                    case 0x7: result = y - x; flag = (byte_vector)(x <= y) & 1; break;
+                    case 0xE: result = source << 1; flag = source >> 7; break;
+                    default: break;
+                }
+
+                vx[chunk] = BLEND(x, result, byte_mask[chunk]);
+
+                if (writes_flag) {
+                    vf[chunk] = BLEND(vf[chunk], flag, byte_mask[chunk]);
+                }
+            }
+            break;
+        }
+
+        case 0xA:
+            for (uint32_t chunk = 0; chunk < word_chunks; chunk++) {
+                index[chunk] = BLEND(index[chunk], (word_vector){0} + NNN, word_mask[chunk]);
+            }
+            break;
+
+        case 0xB: {
+            const half_byte_vector *offset = (const half_byte_vector *)lockstep->V[(quirks & QUIRK_JUMP_VX) ? X : 0];
+
+            for (uint32_t chunk = 0; chunk < word_chunks; chunk++) {
+                const word_vector target = __builtin_convertvector(offset[chunk], word_vector) + NNN;
+
+                pc[chunk] = BLEND(pc[chunk], target, word_mask[chunk]);
+            }
+            return;
+        }
+
+        case 0xF: {
+            const half_byte_vector *offset = (const half_byte_vector *)lockstep->V[X];
+
+            for (uint32_t chunk = 0; chunk < word_chunks; chunk++) {
+                const word_vector sum = index[chunk] + __builtin_convertvector(offset[chunk], word_vector);
+
+                index[chunk] = BLEND(index[chunk], sum, word_mask[chunk]);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    lockstep->synced_lanes &= ~group;
+
+    for (uint32_t chunk = 0; chunk < word_chunks; chunk++) {
+        pc[chunk] = BLEND(pc[chunk], (word_vector){0} + next, word_mask[chunk]);
+    }
+}
+
+static uint16_t fetch_opcode(const chip8_object *chip8, uint16_t program_counter)
+{
+    return (chip8->ram[program_counter] << 8) | chip8->ram[(uint16_t)(program_counter + 1)];
+}
+
+static uint32_t lane_budget(const budget_object *budget, uint32_t lane)
+{
+    return budget->count - budget->uniform - budget->spent[lane];
+}
+
+static void spend_budget(budget_object *budget, uint32_t lane, uint32_t instructions)
+{
+    budget->spent[lane] += instructions;
+
+    if (budget->spent[lane] > budget->most_spent) {
+        budget->most_spent = budget->spent[lane];
+    }
+}
+
+static void retire_lanes(budget_object *budget)
+{
+    if (budget->count - budget->uniform > budget->most_spent) {
+        return;
+    }
+
+    budget->most_spent = 0;
+
+    for (uint64_t pending = budget->active; pending; pending &= pending - 1) {
+        const uint32_t lane = __builtin_ctzll(pending);
+
+        if (lane_budget(budget, lane) == 0) {
+            budget->active &= ~(1ULL << lane);
+        } else if (budget->spent[lane] > budget->most_spent) {
+            budget->most_spent = budget->spent[lane];
+        }
+    }
+}
+
+static uint16_t lowest_program_counter(const lockstep_object *lockstep, uint64_t active)
+{
+    uint16_t lowest = UINT16_MAX;
+
+    for (uint64_t pending = active; pending; pending &= pending - 1) {
+        const uint16_t program_counter = lockstep->program_counter[__builtin_ctzll(pending)];
+
+        if (program_counter < lowest) {
+            lowest = program_counter;
+        }
+    }
+
+    return lowest;
+}
+
+static bool stores_ram(uint16_t opcode)
+{
+    return (opcode & 0xF0FF) == 0xF033 || (opcode & 0xF0FF) == 0xF055 || (opcode & 0xF00F) == 0x5002;
+}
+
+static void mark_code_dirty(lockstep_object *lockstep, uint16_t address)
+{
+    const uint32_t first = address / RAM_BLOCK_SIZE;
+    const uint32_t last = (uint16_t)(address + 15) / RAM_BLOCK_SIZE;
+
+    lockstep->code_dirty[first / 64] |= 1ULL << (first % 64);
+    lockstep->code_dirty[last / 64] |= 1ULL << (last % 64);
+}
+
+static uint64_t program_counter_filter(const lockstep_object *lockstep, uint64_t lanes)
+{
+    uint64_t filter = 0;
+
+    for (uint64_t pending = lanes; pending; pending &= pending - 1) {
+        filter |= 1ULL << ((lockstep->program_counter[__builtin_ctzll(pending)] >> 1) & 63);
+    }
+
+    return filter;
+}
+
+static uint32_t run_scalar(lockstep_object *lockstep, uint32_t lane, uint32_t limit, uint64_t waiting, bool alone)
+{
+    chip8_object *chip8 = &lockstep->instances[lane];
+    const interpreter_function interpret = lockstep->interpret;
+    const uint32_t quirks = lockstep->quirks;
+    const uint64_t filter = alone ? program_counter_filter(lockstep, waiting) : UINT64_MAX;
+    const register_vector stored = store_registers(lockstep, lane);
+    uint16_t opcode = fetch_opcode(chip8, lockstep->program_counter[lane]);
+    uint32_t executed = 0;
+
+    chip8->program_counter = lockstep->program_counter[lane];
+
+    while (executed < limit) {
+        if (stores_ram(opcode)) {
+            mark_code_dirty(lockstep, chip8->I);
+        }
+
+        interpret(chip8);
+        executed++;
+
+        const uint16_t program_counter = chip8->program_counter;
+
+        opcode = fetch_opcode(chip8, program_counter);
+
+        if (((filter >> ((program_counter >> 1) & 63)) & 1) && vector_opcode(opcode, quirks)
+            && (!alone || (matching_lanes(lockstep, program_counter) & waiting))) {
+            break;
+        }
+    }
+
+    load_registers(lockstep, lane, stored);
+    lockstep->program_counter[lane] = chip8->program_counter;
+
+    return executed;
+}
+
+static bool divergent_opcode(uint16_t opcode)
+{
+    switch (opcode >> 12) {
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x9:
+    case 0xB:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void run_lockstep(lockstep_object *lockstep, uint32_t count)
+{
+    budget_object budget = {.count = count, .active = count ? lockstep->lanes : 0};
+    uint64_t converged = 0;
+
+    while (budget.active) {
+        uint16_t program_counter;
+        uint64_t matching;
+
+        if (converged == budget.active) {
+            program_counter = lockstep->program_counter[__builtin_ctzll(budget.active)];
+            matching = budget.active;
+        } else {
+            program_counter = lowest_program_counter(lockstep, budget.active);
+            matching = matching_lanes(lockstep, program_counter) & budget.active;
+        }
+
+        const uint16_t opcode = fetch_opcode(&lockstep->instances[__builtin_ctzll(matching)], program_counter);
+        const uint64_t group = shared_code_lanes(lockstep, matching, program_counter, opcode);
+
+        if ((group & (group - 1)) && vector_opcode(opcode, lockstep->quirks)) {
+            execute_vector(lockstep, group, program_counter, opcode);
+            lockstep->vector_steps += lane_count(lockstep, group);
+            converged = divergent_opcode(opcode) ? 0 : group;
+
+            if (group == budget.active) {
+                budget.uniform++;
+            } else {
+                for (uint64_t pending = group; pending; pending &= pending - 1) {
+                    spend_budget(&budget, __builtin_ctzll(pending), 1);
+                }
+            }
+        } else {
+            const bool alone = !(group & (group - 1));
+            const uint64_t waiting = budget.active & ~group;
+            const uint16_t *program_counters = lockstep->program_counter;
+
+            converged = group;
+
+            for (uint64_t pending = group; pending; pending &= pending - 1) {
+                const uint32_t lane = __builtin_ctzll(pending);
+                const uint32_t executed = run_scalar(lockstep, lane, lane_budget(&budget, lane), waiting, alone);
+
+                spend_budget(&budget, lane, executed);
+                lockstep->scalar_steps += executed;
+
+                if (program_counters[lane] != program_counters[__builtin_ctzll(group)]) {
+                    converged = 0;
+                }
+            }
+        }
+
+        retire_lanes(&budget);
+    }
+}
+
+void tick_lockstep_timers(lockstep_object *lockstep)
+{
+    for (uint32_t lane = 0; lane < lockstep->count; lane++) {
+        tick_timers(&lockstep->instances[lane]);
+    }
+}
+
+chip8_object *sync_lockstep_instance(lockstep_object *lockstep, uint32_t index)
+{
+    store_registers(lockstep, index);
+    lockstep->instances[index].program_counter = lockstep->program_counter[index];
+
+    return &lockstep->instances[index];
+}
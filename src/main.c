@@ -1,8 +1,262 @@
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include "audio.h"
 #include "chip8.h"
+#include "engine.h"
+#include "input_script.h"
 #include "platform.h"
+#include "profile.h"
+#include "rewind.h"
+#include "rom_library.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "thread_queue.h"
+#include "trace.h"
+
+typedef struct {
+    chip8_object chip8;
+    engine_object engine;
+    rewind_object rewind;
+    bool rewind_enabled;
+    movie_object movie;
+    const char *record;
+    const char *replay;
+    uint32_t instructions_per_second;
+    input_queue_object input;
+    triple_buffer_object frames;
+    audio_ring_object audio;
+    beeper_object beeper;
+    atomic_bool quit;
+    uint64_t unpresented_rows;
+#ifdef CHIP8_PROFILE
+    profile_object profile;
+#endif
+#ifdef CHIP8_TRACE
+    trace_object trace;
+#endif
+} emulator_object;
+
+static void handle_snapshot_slot(chip8_object *chip8, uint8_t slot, bool save)
+{
+    char path[512];
+    snprintf(path, sizeof path, "%s.state%u", chip8->rom_name, slot);
+
+    if (save) {
+        if (save_snapshot_file(chip8, path)) {
+            printf("======== SAVED SLOT %u ========\n", slot);
+        }
+        return;
+    }
+
+    if (load_snapshot_file(chip8, path)) {
+        chip8->dirty_rows = UINT64_MAX;
+        printf("======== LOADED SLOT %u ========\n", slot);
+    }
+}
+
+static void apply_input(emulator_object *emulator)
+{
+    chip8_object *chip8 = &emulator->chip8;
+    input_command_object command;
+
+    while (pop_input(&emulator->input, &command)) {
+        switch (command.type)
+        {
+            case INPUT_KEY_DOWN:
+                chip8->keypad[command.value] = true;
+                break;
+
+            case INPUT_KEY_UP:
+                chip8->keypad[command.value] = false;
+                break;
+
+            case INPUT_TOGGLE_PAUSE:
+                if (chip8->state == RUNNING) {
+                    chip8->state = PAUSED;
+                    puts("======== PAUSED ========");
+                    break;
+                }
+
+                chip8->state = RUNNING;
+                break;
+
+            case INPUT_REWIND_START:
+                if (chip8->state == RUNNING) {
+                    chip8->state = REWINDING;
+                }
+                break;
+
+            case INPUT_REWIND_STOP:
+                if (chip8->state == REWINDING) {
+                    chip8->state = RUNNING;
+                }
+                break;
+
+            case INPUT_SAVE_SLOT:
+                handle_snapshot_slot(chip8, command.value, true);
+                break;
+
+            case INPUT_LOAD_SLOT:
+                handle_snapshot_slot(chip8, command.value, false);
+                break;
+        }
+    }
+}
+
+static void publish_chip8(emulator_object *emulator, uint64_t frame)
+{
+    frame_object *published = back_frame(&emulator->frames);
+    const uint64_t dirty_rows = emulator->unpresented_rows | emulator->chip8.dirty_rows;
+
+    memcpy(published->display, emulator->chip8.display, sizeof published->display);
+    published->dirty_rows = dirty_rows;
+    published->hires = emulator->chip8.hires;
+    published->state = emulator->chip8.state;
+    published->frame = frame;
+
+    const bool dropped = publish_frame(&emulator->frames);
+    emulator->unpresented_rows = dropped ? dirty_rows : emulator->chip8.dirty_rows;
+    emulator->chip8.dirty_rows = 0;
+}
+
+static int run_emulation(void *argument)
+{
+    emulator_object *emulator = argument;
+    chip8_object *chip8 = &emulator->chip8;
+    movie_object *movie = &emulator->movie;
+
+#ifdef CHIP8_PROFILE
+    profile_object *profile = &emulator->profile;
+    uint64_t previous_frame = SDL_GetPerformanceCounter();
+    chip8->profile = profile;
+#endif
+
+    instruction_rate_object rate = {.instructions_per_second = emulator->instructions_per_second};
+    scheduler_object scheduler;
+    init_scheduler(&scheduler);
+
+    uint32_t frame = 0;
+    size_t cursor = 0;
+    bool previous_keypad[16] = {0};
+    bool replay_keypad[16] = {0};
+    bool paused = false;
+    const uint32_t restore_count = chip8->restore_count;
+
+    while (!atomic_load(&emulator->quit)) {
+        apply_input(emulator);
+
+        if ((emulator->record || emulator->replay) && chip8->restore_count != restore_count) {
+            SDL_Log("State was restored, movie %s stopped at frame %u\n",
+                emulator->record ? emulator->record : emulator->replay, frame);
+            movie->frame_count = frame;
+            emulator->replay = NULL;
+
+            if (emulator->record) {
+                save_movie(movie, emulator->record);
+                emulator->record = NULL;
+            }
+        }
+
+        if (chip8->state == PAUSED) {
+            if (!paused) {
+                publish_chip8(emulator, frame);
+                paused = true;
+            }
+
+            SDL_Delay(WINDOW_UPDATE_MS);
+            reset_scheduler(&scheduler);
+
+#ifdef CHIP8_PROFILE
+            previous_frame = SDL_GetPerformanceCounter();
+#endif
+            continue;
+        }
+
+        paused = false;
+
+        if (chip8->state == REWINDING) {
+            if (emulator->rewind_enabled) {
+                step_rewind(&emulator->rewind, chip8);
+            }
+
+            publish_chip8(emulator, frame);
+            generate_audio(&emulator->beeper, &emulator->audio, false);
+            wait_next_frame(&scheduler, false);
+
+#ifdef CHIP8_PROFILE
+            previous_frame = SDL_GetPerformanceCounter();
+#endif
+            continue;
+        }
+
+        if (emulator->replay && frame < movie->frame_count) {
+            cursor = apply_input_script(&movie->script, cursor, frame, replay_keypad);
+            memcpy(chip8->keypad, replay_keypad, sizeof chip8->keypad);
+        }
+
+        if (emulator->record && !record_keypad_changes(&movie->script, frame, previous_keypad, chip8->keypad)) {
+            emulator->record = NULL;
+        }
+
+#ifdef CHIP8_PROFILE
+        const uint64_t start_frame = SDL_GetPerformanceCounter();
+#endif
+
+        const bool idle = run_engine(&emulator->engine, chip8, frame_instructions(&rate));
+
+#ifdef CHIP8_PROFILE
+        const uint64_t end_frame = SDL_GetPerformanceCounter();
+#endif
+
+        publish_chip8(emulator, frame);
+        generate_audio(&emulator->beeper, &emulator->audio, chip8->sound_timer > 0);
+        tick_timers(chip8);
+
+        if (emulator->rewind_enabled) {
+            capture_rewind(&emulator->rewind, chip8);
+        }
+
+#ifdef CHIP8_PROFILE
+        const uint64_t end_publish = SDL_GetPerformanceCounter();
+#endif
+
+        wait_next_frame(&scheduler, idle);
+
+#ifdef CHIP8_PROFILE
+        const uint64_t end_sleep = SDL_GetPerformanceCounter();
+        const double counter_ms = 1000.0 / SDL_GetPerformanceFrequency();
+
+        record_frame(profile,
+            (end_frame - start_frame) * counter_ms,
+            (end_publish - end_frame) * counter_ms,
+            (end_sleep - end_publish) * counter_ms,
+            (end_sleep - previous_frame) * counter_ms);
+        previous_frame = end_sleep;
+
+        if (profile->window.frames == WINDOW_HERTZ) {
+            print_profile_line(profile, stdout);
+        }
+#endif
+
+        frame++;
+    }
+
+    if (emulator->record) {
+        movie->frame_count = frame;
+        save_movie(movie, emulator->record);
+    }
+
+#ifdef CHIP8_PROFILE
+    print_profile_report(profile, chip8, stdout);
+    printf("== audio underruns: %u\n", atomic_load(&emulator->audio.underruns));
+#endif
+
+    return 0;
+}
 
 int main(int argc, char **argv)
 {
@@ -11,47 +265,313 @@ int main(int argc, char **argv)
         exit(EXIT_FAILURE);
     }
 
+    uint32_t seed = 0;
+    bool seeded = false;
+    engine_type engine_kind = ENGINE_SWITCH;
+    uint32_t rewind_seconds = REWIND_DEFAULT_SECONDS;
+    size_t rewind_budget = REWIND_DEFAULT_BUDGET;
+    const char *record = NULL;
+    const char *replay = NULL;
+    uint32_t instructions_per_second = INSTRUCTIONS_PER_SECOND;
+    bool rate_given = false;
+    const char *library_path = NULL;
+    const char *trace_path = NULL;
+    quirk_profile quirks = QUIRKS_VIP;
+    bool quirks_given = false;
+
+    for (int index = 2; index < argc; index++) {
+        if (strcmp(argv[index], "--seed") == 0 && index + 1 < argc) {
+            uint64_t value = 0;
+
+            if (!parse_count(argv[++index], 0, UINT32_MAX, &value)) {
+                printf("Invalid seed %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            seed = (uint32_t)value;
+            seeded = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--engine") == 0 && index + 1 < argc) {
+            if (!parse_engine_type(argv[++index], &engine_kind)) {
+                printf("Unknown engine %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[index], "--rewind-seconds") == 0 && index + 1 < argc) {
+            uint64_t seconds = 0;
+
+            if (!parse_count(argv[++index], 0, UINT32_MAX / WINDOW_HERTZ, &seconds)) {
+                printf("Invalid rewind length %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            rewind_seconds = (uint32_t)seconds;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--rewind-kb") == 0 && index + 1 < argc) {
+            uint64_t kilobytes = 0;
+
+            if (!parse_count(argv[++index], 0, SIZE_MAX / 1024, &kilobytes)) {
+                printf("Invalid rewind budget %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            rewind_budget = (size_t)kilobytes * 1024;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--ips") == 0 && index + 1 < argc) {
+            uint64_t rate = 0;
+
+            if (!parse_count(argv[++index], 1, UINT32_MAX, &rate)) {
+                printf("Invalid instruction rate %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            instructions_per_second = (uint32_t)rate;
+            rate_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--quirks") == 0 && index + 1 < argc) {
+            if (!parse_quirk_profile(argv[++index], &quirks)) {
+                printf("Unknown quirk profile %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            quirks_given = true;
+            continue;
+        }
+
+        if (strcmp(argv[index], "--record") == 0 && index + 1 < argc) {
+            record = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--replay") == 0 && index + 1 < argc) {
+            replay = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--library") == 0 && index + 1 < argc) {
+            library_path = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--trace") == 0 && index + 1 < argc) {
+            trace_path = argv[++index];
+            continue;
+        }
+
+        printf("Unknown option %s\n", argv[index]);
+        exit(EXIT_FAILURE);
+    }
+
+#ifndef CHIP8_TRACE
+    if (trace_path) {
+        printf("Tracing needs a build with TRACE=1\n");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    if (trace_path && engine_kind != ENGINE_SWITCH) {
+        printf("Traces only cover the switch engine, --trace cannot be used with --engine threaded or jit\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *rom_name = argv[1];
+    rom_library_object library = {0};
+    const rom_entry_object *rom = NULL;
+
+    if (library_path) {
+        if (!open_rom_library(&library, library_path)) {
+            exit(EXIT_FAILURE);
+        }
+
+        rom = find_rom(&library, rom_name);
+
+        if (!rom) {
+            printf("Rom %s is not in library %s\n", rom_name, library_path);
+            close_rom_library(&library);
+            exit(EXIT_FAILURE);
+        }
+
+        if (!rate_given && rom->metadata.instructions_per_second > 0) {
+            instructions_per_second = rom->metadata.instructions_per_second;
+        }
+
+        if (!quirks_given && rom->metadata.quirks[0] && !parse_quirk_profile(rom->metadata.quirks, &quirks)) {
+            printf("Rom %s has unknown quirk profile %s\n", rom->name, rom->metadata.quirks);
+            close_rom_library(&library);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    static emulator_object emulator;
+    movie_object *movie = &emulator.movie;
+
+    *movie = (movie_object){
+        .seed = seeded ? seed : (uint32_t)time(NULL),
+        .instructions_per_second = instructions_per_second,
+        .quirks = quirks,
+    };
+
+    if (replay) {
+        if (!load_movie(movie, replay)) {
+            exit(EXIT_FAILURE);
+        }
+
+        if (quirks_given && quirks != movie->quirks) {
+            printf("Movie %s was recorded with quirk profile %s\n", replay, quirk_profile_name(movie->quirks));
+            exit(EXIT_FAILURE);
+        }
+
+        instructions_per_second = movie->instructions_per_second;
+        quirks = movie->quirks;
+        record = NULL;
+    }
+
+    if (record || replay) {
+        seed = movie->seed;
+        seeded = true;
+        rewind_seconds = 0;
+    }
+
+    init_audio_ring(&emulator.audio);
+
     sdl_object sdl = {0};
-    bool sdl_initialized = init_sdl(&sdl);
+    bool sdl_initialized = init_sdl(&sdl, &emulator.audio);
 
     if (!sdl_initialized) {
         exit(EXIT_FAILURE);
     }
 
-    chip8_object chip8 = {0};
+    chip8_object *chip8 = &emulator.chip8;
 
-    const char *rom_name = argv[1];
-    bool chip8_initialized = init_chip8(&chip8, rom_name);
+    bool chip8_initialized = rom
+        ? load_chip8(chip8, rom->data, rom->size, rom->name)
+        : init_chip8(chip8, rom_name);
 
     if (!chip8_initialized) {
         cleanup(&sdl);
         exit(EXIT_FAILURE);
     }
 
+    if (replay && chip8->rom_hash != movie->rom_hash) {
+        SDL_Log("Movie %s was recorded with a different rom\n", replay);
+        cleanup(&sdl);
+        exit(EXIT_FAILURE);
+    }
+
+    movie->rom_hash = chip8->rom_hash;
+    chip8->quirks = quirks;
+
+    if (seeded) {
+        seed_chip8(chip8, seed);
+    }
+
+    bool engine_initialized = init_engine(&emulator.engine, engine_kind);
+
+    if (!engine_initialized) {
+        cleanup(&sdl);
+        exit(EXIT_FAILURE);
+    }
+
+    emulator.rewind_enabled = rewind_seconds > 0 && rewind_budget > 0;
+
+    if (emulator.rewind_enabled && !init_rewind(&emulator.rewind, rewind_budget, rewind_seconds * WINDOW_HERTZ)) {
+        destroy_engine(&emulator.engine);
+        cleanup(&sdl);
+        exit(EXIT_FAILURE);
+    }
+
+#ifdef CHIP8_PROFILE
+    if (engine_kind != ENGINE_SWITCH) {
+        SDL_Log("Opcode and address counts only cover instructions run by emulate_instruction\n");
+    }
+#endif
+
+#ifdef CHIP8_TRACE
+    if (trace_path) {
+        if (!start_trace(&emulator.trace, trace_path, chip8)) {
+            destroy_engine(&emulator.engine);
+            cleanup(&sdl);
+            exit(EXIT_FAILURE);
+        }
+
+        chip8->trace = &emulator.trace;
+    }
+#endif
+
+    emulator.record = record;
+    emulator.replay = replay;
+    emulator.instructions_per_second = instructions_per_second;
+    init_input_queue(&emulator.input);
+    init_triple_buffer(&emulator.frames);
+    atomic_init(&emulator.quit, false);
+    init_beeper(&emulator.beeper, &emulator.audio, (uint32_t)sdl.have.freq, sdl.have.samples);
+
     clear_screen(&sdl);
+    pause_audio(&sdl, false);
+
+    SDL_Thread *emulation_thread = SDL_CreateThread(run_emulation, "emulation", &emulator);
+
+    if (!emulation_thread) {
+        SDL_Log("Could not create emulation thread %s\n", SDL_GetError());
+        atomic_store(&emulator.quit, true);
+    }
+
+    emulator_state shown_state = RUNNING;
 
-    while (chip8.state != QUIT) {
-        handle_input(&chip8);
+    while (emulation_thread && handle_input(&emulator.input, shown_state == PAUSED ? PAUSED_WAIT_MS : 0)) {
+        const frame_object *frame = acquire_frame(&emulator.frames);
 
-        if (chip8.state == PAUSED) {
+        if (!frame) {
+            if (shown_state != PAUSED) {
+                SDL_Delay(1);
+            }
             continue;
         }
 
-        const uint64_t start_frame = SDL_GetPerformanceCounter();
+        if ((frame->state == PAUSED) != (shown_state == PAUSED)) {
+            pause_audio(&sdl, frame->state == PAUSED);
+        }
+
+        shown_state = frame->state;
 
-        for (uint32_t index = 0; index < INSTRUCTIONS_PER_SECOND / WINDOW_HERTZ; index++) {
-            emulate_instruction(&chip8);
+#ifdef CHIP8_PROFILE
+        const uint64_t start_render = SDL_GetPerformanceCounter();
+
+        if (update_screen(&sdl, frame)) {
+            const uint64_t render_ticks = SDL_GetPerformanceCounter() - start_render;
+            record_render(&emulator.profile, render_ticks * 1000000000ULL / SDL_GetPerformanceFrequency());
         }
+#else
+        update_screen(&sdl, frame);
+#endif
+    }
 
-        const uint64_t end_frame = SDL_GetPerformanceCounter();
-        const double time_elapsed = (double)((end_frame - start_frame) * 1000) / SDL_GetPerformanceFrequency();
+    atomic_store(&emulator.quit, true);
+
+    if (emulation_thread) {
+        SDL_WaitThread(emulation_thread, NULL);
+    }
+
+#ifdef CHIP8_TRACE
+    if (chip8->trace && !stop_trace(chip8->trace)) {
+        SDL_Log("Trace %s is incomplete\n", trace_path);
+    }
+#endif
+
+    free_input_script(&emulator.movie.script);
 
-        SDL_Delay(WINDOW_UPDATE_MS > time_elapsed ? WINDOW_UPDATE_MS - time_elapsed : 0);
-        update_screen(&sdl, &chip8);
-        update_timers(&sdl, &chip8);
+    if (emulator.rewind_enabled) {
+        destroy_rewind(&emulator.rewind);
     }
 
+    destroy_engine(&emulator.engine);
+    close_rom_library(&library);
     cleanup(&sdl);
 
-    exit(EXIT_SUCCESS);
+    exit(emulation_thread ? EXIT_SUCCESS : EXIT_FAILURE);
 }
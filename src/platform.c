@@ -1,23 +1,21 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "platform.h"
 
+static const uint32_t palette[1 << DISPLAY_PLANES] = {0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555};
+
 static void audio_callback(void *userdata, uint8_t *stream, int length)
 {
-    (void)userdata;
-
+    audio_ring_object *ring = userdata;
     int16_t *audio_data = (int16_t *)stream;
-    static uint32_t running_sample_index = 0;
-
-    const int32_t square_wave_period = AUDIO_SAMPLE_RATE / SOUND_WAVE_FREQUENCY;
-    const int32_t half_square_wave_period = square_wave_period / 2;
+    const uint32_t samples = (uint32_t)length / sizeof *audio_data;
 
-    for (int index = 0; index < length / 2; index++) {
-        audio_data[index] = ((running_sample_index++ / half_square_wave_period) % 2) ? VOLUME : -VOLUME;
-    }
+    const uint32_t read = pop_audio(ring, audio_data, samples);
+    memset(audio_data + read, 0, (samples - read) * sizeof *audio_data);
 }
 
-bool init_sdl(sdl_object *sdl)
+bool init_sdl(sdl_object *sdl, audio_ring_object *audio)
 {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) != 0) {
         SDL_Log("Could not initialize SDL subsystems! %s\n", SDL_GetError());
@@ -40,19 +38,35 @@ bool init_sdl(sdl_object *sdl)
     }
 
     int8_t sdl_driver_index = -1;
-    sdl->renderer = SDL_CreateRenderer(sdl->window, sdl_driver_index, SDL_RENDERER_ACCELERATED);
+    sdl->renderer = SDL_CreateRenderer(sdl->window, sdl_driver_index, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
 
     if (!sdl->renderer) {
         SDL_Log("Could not create SDL renderer %s\n", SDL_GetError());
         return false;
     }
 
+    sdl->texture = SDL_CreateTexture(
+        sdl->renderer,
+        SDL_PIXELFORMAT_ARGB8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        DISPLAY_WIDTH,
+        DISPLAY_HEIGHT
+    );
+
+    if (!sdl->texture) {
+        SDL_Log("Could not create SDL texture %s\n", SDL_GetError());
+        return false;
+    }
+
+    sdl->presented_valid = false;
+
     sdl->want = (SDL_AudioSpec){
-        .freq = 44100,
+        .freq = AUDIO_SAMPLE_RATE,
         .format = AUDIO_S16LSB,
         .channels = 1,
         .samples = 512,
         .callback = audio_callback,
+        .userdata = audio,
     };
 
     sdl->device = SDL_OpenAudioDevice(NULL, 0, &sdl->want, &sdl->have, 0);
@@ -72,6 +86,7 @@ bool init_sdl(sdl_object *sdl)
 
 void cleanup(const sdl_object *sdl)
 {
+    SDL_DestroyTexture(sdl->texture);
     SDL_DestroyRenderer(sdl->renderer);
     SDL_DestroyWindow(sdl->window);
     SDL_CloseAudioDevice(sdl->device);
@@ -84,208 +99,186 @@ void clear_screen(const sdl_object *sdl)
     SDL_RenderClear(sdl->renderer);
 }
 
-void update_screen(const sdl_object *sdl, const chip8_object *chip8)
+bool update_screen(sdl_object *sdl, const frame_object *frame)
 {
-    SDL_Rect rectangle = {.x = 0, .y = 0, .w = WINDOW_SCALE_FACTOR, .h = WINDOW_SCALE_FACTOR};
+    const uint32_t width = SCREEN_WIDTH(frame->hires);
+    const uint32_t height = SCREEN_HEIGHT(frame->hires);
+    const uint64_t screen_rows = height == 64 ? UINT64_MAX : (1ULL << height) - 1;
+    uint64_t dirty_rows = frame->dirty_rows & screen_rows;
+
+    if (!sdl->presented_valid || sdl->presented_hires != frame->hires) {
+        dirty_rows = screen_rows;
+    }
 
-    for (uint32_t index = 0; index < sizeof chip8->display; index++) {
-        rectangle.x = (index % WINDOW_WIDTH) * WINDOW_SCALE_FACTOR;
-        rectangle.y = (index / WINDOW_WIDTH) * WINDOW_SCALE_FACTOR;
+    if (dirty_rows == 0) {
+        return false;
+    }
+
+    const uint32_t first_row = __builtin_ctzll(dirty_rows);
+    const uint32_t last_row = 63 - __builtin_clzll(dirty_rows);
+    const SDL_Rect dirty_area = {
+        .x = 0,
+        .y = first_row,
+        .w = width,
+        .h = last_row - first_row + 1,
+    };
+    const SDL_Rect screen_area = {
+        .x = 0,
+        .y = 0,
+        .w = width,
+        .h = height,
+    };
+
+    void *pixels = NULL;
+    int pitch = 0;
 
-        if (chip8->display[index]) {
-            SDL_SetRenderDrawColor(sdl->renderer, 255, 255, 255, SDL_ALPHA_OPAQUE);
-            SDL_RenderFillRect(sdl->renderer, &rectangle);
+    if (SDL_LockTexture(sdl->texture, &dirty_area, &pixels, &pitch) != 0) {
+        SDL_Log("Could not lock SDL texture %s\n", SDL_GetError());
+        return false;
+    }
+
+    for (uint32_t y = first_row; y <= last_row; y++) {
+        uint32_t *texture_row = (uint32_t *)((uint8_t *)pixels + (y - first_row) * pitch);
 
-            if (PIXEL_OUTLINE) {
-                SDL_SetRenderDrawColor(sdl->renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
-                SDL_RenderDrawRect(sdl->renderer, &rectangle);
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t color = 0;
+
+            for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+                color |= DISPLAY_PIXEL(frame->display[plane], x, y) << plane;
             }
 
-            continue;
+            texture_row[x] = palette[color];
         }
+    }
+
+    SDL_UnlockTexture(sdl->texture);
+    SDL_RenderCopy(sdl->renderer, sdl->texture, &screen_area, NULL);
+
+    if (PIXEL_OUTLINE) {
+        const uint32_t scale = WINDOW_WIDTH * WINDOW_SCALE_FACTOR / width;
 
         SDL_SetRenderDrawColor(sdl->renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
-        SDL_RenderFillRect(sdl->renderer, &rectangle);
+
+        for (uint32_t x = 0; x < width; x++) {
+            SDL_RenderDrawLine(sdl->renderer, x * scale, 0, x * scale, height * scale);
+        }
+
+        for (uint32_t y = 0; y < height; y++) {
+            SDL_RenderDrawLine(sdl->renderer, 0, y * scale, width * scale, y * scale);
+        }
     }
 
     SDL_RenderPresent(sdl->renderer);
+
+    sdl->presented_hires = frame->hires;
+    sdl->presented_valid = true;
+    return true;
 }
 
-void update_timers(const sdl_object *sdl, chip8_object *chip8)
+void pause_audio(const sdl_object *sdl, bool paused)
 {
-    if (chip8->delay_timer > 0) {
-        chip8->delay_timer--;
-    }
+    SDL_PauseAudioDevice(sdl->device, paused);
+}
 
-    if (chip8->sound_timer > 0) {
-        chip8->sound_timer--;
-        SDL_PauseAudioDevice(sdl->device, 0);
-        return;
+static int8_t keypad_index(SDL_Keycode key)
+{
+    switch (key)
+    {
+        case SDLK_1:
+            return 0x1;
+        case SDLK_2:
+            return 0x2;
+        case SDLK_3:
+            return 0x3;
+        case SDLK_4:
+            return 0xC;
+        case SDLK_q:
+            return 0x4;
+        case SDLK_w:
+            return 0x5;
+        case SDLK_e:
+            return 0x6;
+        case SDLK_r:
+            return 0xD;
+        case SDLK_a:
+            return 0x7;
+        case SDLK_s:
+            return 0x8;
+        case SDLK_d:
+            return 0x9;
+        case SDLK_f:
+            return 0xE;
+        case SDLK_z:
+            return 0xA;
+        case SDLK_x:
+            return 0x0;
+        case SDLK_c:
+            return 0xB;
+        case SDLK_v:
+            return 0xF;
+        default:
+            return -1;
     }
+}
 
-    SDL_PauseAudioDevice(sdl->device, 1);
+static void send_input(input_queue_object *queue, input_command_type type, uint8_t value)
+{
+    if (!push_input(queue, (input_command_object){.type = type, .value = value})) {
+        SDL_Log("Input queue is full, dropping event\n");
+    }
 }
 
-void handle_input(chip8_object *chip8)
+bool handle_input(input_queue_object *queue, int32_t timeout_ms)
 {
     SDL_Event event;
+    bool running = true;
+    bool pending = timeout_ms > 0 ? SDL_WaitEventTimeout(&event, timeout_ms) : SDL_PollEvent(&event);
 
-    while (SDL_PollEvent(&event)) {
+    for (; pending; pending = SDL_PollEvent(&event)) {
         switch (event.type) {
         case SDL_QUIT:
-            chip8->state = QUIT;
+            running = false;
             break;
 
-        case SDL_KEYDOWN:
-            switch (event.key.keysym.sym) {
-                case SDLK_ESCAPE:
-                    chip8->state = QUIT;
-                    break;
-                case SDLK_SPACE:
-                    if (chip8->state == RUNNING) {
-                        chip8->state = PAUSED;
-                        puts("======== PAUSED ========");
-                        break;
-                    }
-
-                    chip8->state = RUNNING;
-                    break;
-
-                case SDLK_1:
-                    chip8->keypad[0x1] = true;
-                    break;
-
-                case SDLK_2:
-                    chip8->keypad[0x2] = true;
-                    break;
-
-                case SDLK_3:
-                    chip8->keypad[0x3] = true;
-                    break;
-
-                case SDLK_4:
-                    chip8->keypad[0xC] = true;
-                    break;
-
-                case SDLK_q:
-                    chip8->keypad[0x4] = true;
-                    break;
-
-                case SDLK_w:
-                    chip8->keypad[0x5] = true;
-                    break;
-
-                case SDLK_e:
-                    chip8->keypad[0x6] = true;
-                    break;
-
-                case SDLK_r:
-                    chip8->keypad[0xD] = true;
-                    break;
-
-                case SDLK_a:
-                    chip8->keypad[0x7] = true;
-                    break;
-
-                case SDLK_s:
-                    chip8->keypad[0x8] = true;
-                    break;
-
-                case SDLK_d:
-                    chip8->keypad[0x9] = true;
-                    break;
-
-                case SDLK_f:
-                    chip8->keypad[0xE] = true;
-                    break;
-
-                case SDLK_z:
-                    chip8->keypad[0xA] = true;
-                    break;
-
-                case SDLK_x:
-                    chip8->keypad[0x0] = true;
-                    break;
-
-                case SDLK_c:
-                    chip8->keypad[0xB] = true;
-                    break;
-
-                case SDLK_v:
-                    chip8->keypad[0xF] = true;
-                    break;
+        case SDL_KEYDOWN: {
+            const SDL_Keycode key = event.key.keysym.sym;
+            const int8_t index = keypad_index(key);
+
+            if (index >= 0) {
+                send_input(queue, INPUT_KEY_DOWN, index);
+                break;
+            }
+
+            if (key == SDLK_ESCAPE) {
+                running = false;
+            } else if (key == SDLK_SPACE) {
+                send_input(queue, INPUT_TOGGLE_PAUSE, 0);
+            } else if (key == SDLK_BACKSPACE && !event.key.repeat) {
+                send_input(queue, INPUT_REWIND_START, 0);
+            } else if (key >= SDLK_F1 && key <= SDLK_F4) {
+                send_input(queue, INPUT_SAVE_SLOT, key - SDLK_F1 + 1);
+            } else if (key >= SDLK_F5 && key <= SDLK_F8) {
+                send_input(queue, INPUT_LOAD_SLOT, key - SDLK_F5 + 1);
             }
             break;
+        }
+
+        case SDL_KEYUP: {
+            const SDL_Keycode key = event.key.keysym.sym;
+            const int8_t index = keypad_index(key);
 
-        case SDL_KEYUP:
-            switch (event.key.keysym.sym)
-            {
-                case SDLK_1:
-                    chip8->keypad[0x1] = false;
-                    break;
-
-                case SDLK_2:
-                    chip8->keypad[0x2] = false;
-                    break;
-
-                case SDLK_3:
-                    chip8->keypad[0x3] = false;
-                    break;
-
-                case SDLK_4:
-                    chip8->keypad[0xC] = false;
-                    break;
-
-                case SDLK_q:
-                    chip8->keypad[0x4] = false;
-                    break;
-
-                case SDLK_w:
-                    chip8->keypad[0x5] = false;
-                    break;
-
-                case SDLK_e:
-                    chip8->keypad[0x6] = false;
-                    break;
-
-                case SDLK_r:
-                    chip8->keypad[0xD] = false;
-                    break;
-
-                case SDLK_a:
-                    chip8->keypad[0x7] = false;
-                    break;
-
-                case SDLK_s:
-                    chip8->keypad[0x8] = false;
-                    break;
-
-                case SDLK_d:
-                    chip8->keypad[0x9] = false;
-                    break;
-
-                case SDLK_f:
-                    chip8->keypad[0xE] = false;
-                    break;
-
-                case SDLK_z:
-                    chip8->keypad[0xA] = false;
-                    break;
-
-                case SDLK_x:
-                    chip8->keypad[0x0] = false;
-                    break;
-
-                case SDLK_c:
-                    chip8->keypad[0xB] = false;
-                    break;
-
-                case SDLK_v:
-                    chip8->keypad[0xF] = false;
-                    break;
-                default:
-                    break;
+            if (index >= 0) {
+                send_input(queue, INPUT_KEY_UP, index);
+            } else if (key == SDLK_BACKSPACE) {
+                send_input(queue, INPUT_REWIND_STOP, 0);
             }
+            break;
+        }
+
+        default:
+            break;
         }
     }
+
+    return running;
 }
@@ -0,0 +1,145 @@
+#include "profile.h"
+
+static const char *const family_names[16] = {
+    "0NNN cls/ret", "1NNN jp", "2NNN call", "3XNN se", "4XNN sne", "5XY0 se", "6XNN ld", "7XNN add",
+    "8XYN alu", "9XY0 sne", "ANNN ld i", "BNNN jp v0", "CXNN rnd", "DXYN drw", "EXNN skp", "FXNN misc",
+};
+
+static double max_value(double first, double second)
+{
+    return first > second ? first : second;
+}
+
+static void add_frame(frame_stats_object *stats, double emulate_ms, double publish_ms, double sleep_ms, double frame_ms)
+{
+    stats->frames++;
+    stats->missed += frame_ms > 1000.0 / WINDOW_HERTZ + 1.0;
+    stats->emulate_ms += emulate_ms;
+    stats->publish_ms += publish_ms;
+    stats->sleep_ms += sleep_ms;
+    stats->frame_ms += frame_ms;
+    stats->max_emulate_ms = max_value(stats->max_emulate_ms, emulate_ms);
+    stats->max_publish_ms = max_value(stats->max_publish_ms, publish_ms);
+    stats->max_frame_ms = max_value(stats->max_frame_ms, frame_ms);
+}
+
+void record_frame(profile_object *profile, double emulate_ms, double publish_ms, double sleep_ms, double frame_ms)
+{
+    add_frame(&profile->total, emulate_ms, publish_ms, sleep_ms, frame_ms);
+    add_frame(&profile->window, emulate_ms, publish_ms, sleep_ms, frame_ms);
+}
+
+static void add_render(render_stats_object *stats, uint64_t render_ns)
+{
+    atomic_fetch_add_explicit(&stats->frames, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->total_ns, render_ns, memory_order_relaxed);
+
+    if (render_ns > atomic_load_explicit(&stats->max_ns, memory_order_relaxed)) {
+        atomic_store_explicit(&stats->max_ns, render_ns, memory_order_relaxed);
+    }
+}
+
+void record_render(profile_object *profile, uint64_t render_ns)
+{
+    add_render(&profile->render_total, render_ns);
+    add_render(&profile->render_window, render_ns);
+}
+
+static double render_average_ms(uint64_t frames, uint64_t total_ns)
+{
+    return frames > 0 ? total_ns / 1e6 / frames : 0.0;
+}
+
+void print_profile_line(profile_object *profile, FILE *file)
+{
+    const frame_stats_object *window = &profile->window;
+
+    if (window->frames == 0) {
+        return;
+    }
+
+    const uint64_t rendered = atomic_exchange_explicit(&profile->render_window.frames, 0, memory_order_relaxed);
+    const uint64_t render_ns = atomic_exchange_explicit(&profile->render_window.total_ns, 0, memory_order_relaxed);
+    atomic_store_explicit(&profile->render_window.max_ns, 0, memory_order_relaxed);
+
+    fprintf(file, "fps %5.1f | emulate %6.3f ms | publish %6.3f ms | sleep %6.3f ms | render %6.3f ms x%llu | worst frame %6.2f ms | missed %llu\n",
+        window->frame_ms > 0 ? window->frames * 1000.0 / window->frame_ms : 0.0,
+        window->emulate_ms / window->frames,
+        window->publish_ms / window->frames,
+        window->sleep_ms / window->frames,
+        render_average_ms(rendered, render_ns),
+        (unsigned long long)rendered,
+        window->max_frame_ms,
+        (unsigned long long)window->missed);
+
+    profile->window = (frame_stats_object){0};
+}
+
+void print_profile_report(const profile_object *profile, const chip8_object *chip8, FILE *file)
+{
+    fprintf(file, "== profile: %llu instructions ==\n", (unsigned long long)profile->instructions);
+
+    for (uint8_t family = 0; family < 16; family++) {
+        if (profile->family_counts[family] == 0) {
+            continue;
+        }
+
+        fprintf(file, "%-14s %12llu %6.2f%%\n",
+            family_names[family],
+            (unsigned long long)profile->family_counts[family],
+            profile->family_counts[family] * 100.0 / profile->instructions);
+    }
+
+    bool reported[MEMORY_SIZE] = {false};
+
+    fprintf(file, "== hottest addresses ==\n");
+
+    for (uint32_t rank = 0; rank < PROFILE_HOT_ADDRESSES; rank++) {
+        uint32_t hottest = 0;
+        uint64_t hits = 0;
+
+        for (uint32_t address = 0; address < MEMORY_SIZE; address++) {
+            if (!reported[address] && profile->address_hits[address] > hits) {
+                hottest = address;
+                hits = profile->address_hits[address];
+            }
+        }
+
+        if (hits == 0) {
+            break;
+        }
+
+        reported[hottest] = true;
+        fprintf(file, "0x%03X %04X %12llu %6.2f%%\n",
+            hottest,
+            (chip8->ram[hottest] << 8) | chip8->ram[(hottest + 1) & (MEMORY_SIZE - 1)],
+            (unsigned long long)hits,
+            hits * 100.0 / profile->instructions);
+    }
+
+    const frame_stats_object *total = &profile->total;
+
+    if (total->frames == 0) {
+        return;
+    }
+
+    fprintf(file, "== frames: %llu, %.1f fps, %llu missed the %.2f ms deadline ==\n",
+        (unsigned long long)total->frames,
+        total->frame_ms > 0 ? total->frames * 1000.0 / total->frame_ms : 0.0,
+        (unsigned long long)total->missed,
+        1000.0 / WINDOW_HERTZ);
+    fprintf(file, "emulate avg %6.3f ms max %6.3f ms\n", total->emulate_ms / total->frames, total->max_emulate_ms);
+    fprintf(file, "publish avg %6.3f ms max %6.3f ms\n", total->publish_ms / total->frames, total->max_publish_ms);
+    fprintf(file, "sleep   avg %6.3f ms\n", total->sleep_ms / total->frames);
+    fprintf(file, "frame   avg %6.3f ms max %6.3f ms\n", total->frame_ms / total->frames, total->max_frame_ms);
+
+    const uint64_t rendered = atomic_load_explicit(&profile->render_total.frames, memory_order_relaxed);
+    const double render_ms = render_average_ms(rendered, atomic_load_explicit(&profile->render_total.total_ns, memory_order_relaxed));
+    const double emulation_ms = (total->emulate_ms + total->publish_ms) / total->frames;
+
+    fprintf(file, "render  avg %6.3f ms max %6.3f ms over %llu presented frames\n",
+        render_ms,
+        atomic_load_explicit(&profile->render_total.max_ns, memory_order_relaxed) / 1e6,
+        (unsigned long long)rendered);
+    fprintf(file, "bound by %s thread\n", render_ms > emulation_ms ? "render" : "emulation");
+}
@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+
+#define MAX_BLOCK_ENCODING (RAM_BLOCK_SIZE * 3)
+#define DISPLAY_ROW_SIZE (DISPLAY_WORDS * sizeof(uint64_t))
+#define MAX_RECORD_SIZE \
+    (sizeof(rewind_registers_object) + sizeof(uint16_t) + sizeof(uint64_t) * RAM_DIRTY_WORDS \
+     + RAM_BLOCKS * MAX_BLOCK_ENCODING \
+     + DISPLAY_PLANES * (sizeof(uint64_t) + DISPLAY_HEIGHT * DISPLAY_ROW_SIZE))
+#define FRAMING_SIZE (2 * sizeof(uint32_t))
+
+static void save_registers(rewind_registers_object *registers, const chip8_object *chip8)
+{
+    *registers = (rewind_registers_object){0};
+    memcpy(registers->stack, chip8->stack, sizeof registers->stack);
+    registers->stack_index = (uint8_t)(chip8->stack_pointer - chip8->stack);
+    memcpy(registers->V, chip8->V, sizeof registers->V);
+    registers->I = chip8->I;
+    registers->program_counter = chip8->program_counter;
+    registers->delay_timer = chip8->delay_timer;
+    registers->sound_timer = chip8->sound_timer;
+    registers->key_pending = chip8->key_pending;
+    registers->pending_key = chip8->pending_key;
+    registers->rng_state = chip8->rng_state;
+    registers->hires = chip8->hires;
+    registers->planes = chip8->planes;
+    memcpy(registers->rpl, chip8->rpl, sizeof registers->rpl);
+}
+
+static void load_registers(chip8_object *chip8, const rewind_registers_object *registers)
+{
+    memcpy(chip8->stack, registers->stack, sizeof chip8->stack);
+    chip8->stack_pointer = &chip8->stack[registers->stack_index];
+    memcpy(chip8->V, registers->V, sizeof chip8->V);
+    chip8->I = registers->I;
+    chip8->program_counter = registers->program_counter;
+    chip8->delay_timer = registers->delay_timer;
+    chip8->sound_timer = registers->sound_timer;
+    chip8->key_pending = registers->key_pending;
+    chip8->pending_key = registers->pending_key;
+    chip8->rng_state = registers->rng_state;
+    chip8->hires = registers->hires;
+    chip8->planes = registers->planes;
+    memcpy(chip8->rpl, registers->rpl, sizeof chip8->rpl);
+}
+
+static size_t encode_xor_block(uint8_t *output, const uint8_t *current, const uint8_t *previous)
+{
+    size_t used = 0;
+    uint32_t index = 0;
+
+    while (index < RAM_BLOCK_SIZE) {
+        uint8_t skip = 0;
+        uint8_t count = 0;
+
+        while (index < RAM_BLOCK_SIZE && skip < UINT8_MAX && current[index] == previous[index]) {
+            skip++;
+            index++;
+        }
+
+        while (index < RAM_BLOCK_SIZE && count < UINT8_MAX && current[index] != previous[index]) {
+            output[used + 2 + count++] = current[index] ^ previous[index];
+            index++;
+        }
+
+        output[used] = skip;
+        output[used + 1] = count;
+        used += 2 + count;
+    }
+
+    return used;
+}
+
+static size_t apply_xor_block(const uint8_t *input, uint8_t *first, uint8_t *second)
+{
+    size_t used = 0;
+    uint32_t index = 0;
+
+    while (index < RAM_BLOCK_SIZE) {
+        const uint8_t skip = input[used];
+        const uint8_t count = input[used + 1];
+        used += 2;
+        index += skip;
+
+        for (uint8_t byte = 0; byte < count; byte++, index++) {
+            first[index] ^= input[used];
+            second[index] ^= input[used];
+            used++;
+        }
+    }
+
+    return used;
+}
+
+static void ring_write(rewind_object *rewind, const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+    const size_t first_part = (length < rewind->capacity - rewind->head) ? length : rewind->capacity - rewind->head;
+
+    memcpy(rewind->buffer + rewind->head, bytes, first_part);
+    memcpy(rewind->buffer, bytes + first_part, length - first_part);
+
+    rewind->head = (rewind->head + length) % rewind->capacity;
+    rewind->used += length;
+}
+
+static void ring_read(const rewind_object *rewind, size_t offset, void *data, size_t length)
+{
+    uint8_t *bytes = data;
+    offset %= rewind->capacity;
+    const size_t first_part = (length < rewind->capacity - offset) ? length : rewind->capacity - offset;
+
+    memcpy(bytes, rewind->buffer + offset, first_part);
+    memcpy(bytes + first_part, rewind->buffer, length - first_part);
+}
+
+static void drop_oldest(rewind_object *rewind)
+{
+    uint32_t length = 0;
+    const size_t oldest = (rewind->head + rewind->capacity - rewind->used) % rewind->capacity;
+
+    ring_read(rewind, oldest, &length, sizeof length);
+    rewind->used -= length + FRAMING_SIZE;
+    rewind->frame_count--;
+}
+
+static void push_record(rewind_object *rewind, const uint8_t *record, uint32_t length)
+{
+    if (length + FRAMING_SIZE > rewind->capacity) {
+        rewind->head = 0;
+        rewind->used = 0;
+        rewind->frame_count = 0;
+        return;
+    }
+
+    while (rewind->frame_count > 0
+        && (rewind->used + length + FRAMING_SIZE > rewind->capacity || rewind->frame_count >= rewind->max_frames)) {
+        drop_oldest(rewind);
+    }
+
+    ring_write(rewind, &length, sizeof length);
+    ring_write(rewind, record, length);
+    ring_write(rewind, &length, sizeof length);
+    rewind->frame_count++;
+}
+
+static uint32_t pop_record(rewind_object *rewind, uint8_t *record)
+{
+    uint32_t length = 0;
+    const size_t trailer = rewind->head + rewind->capacity - sizeof length;
+
+    ring_read(rewind, trailer, &length, sizeof length);
+    ring_read(rewind, trailer - length, record, length);
+
+    rewind->head = (rewind->head + rewind->capacity - length - FRAMING_SIZE) % rewind->capacity;
+    rewind->used -= length + FRAMING_SIZE;
+    rewind->frame_count--;
+    return length;
+}
+
+static void prime_rewind(rewind_object *rewind, chip8_object *chip8)
+{
+    save_registers(&rewind->registers, chip8);
+    memcpy(rewind->ram, chip8->ram, sizeof rewind->ram);
+    memcpy(rewind->display, chip8->display, sizeof rewind->display);
+
+    rewind->head = 0;
+    rewind->used = 0;
+    rewind->frame_count = 0;
+    rewind->primed = true;
+    rewind->restore_count = chip8->restore_count;
+    clear_ram_dirty(chip8);
+}
+
+bool init_rewind(rewind_object *rewind, size_t budget, uint32_t max_frames)
+{
+    rewind->buffer = malloc(budget);
+    rewind->record = malloc(MAX_RECORD_SIZE);
+
+    if (!rewind->buffer || !rewind->record) {
+        fprintf(stderr, "Could not allocate %zu bytes for the rewind buffer\n", budget + MAX_RECORD_SIZE);
+        destroy_rewind(rewind);
+        return false;
+    }
+
+    rewind->capacity = budget;
+    rewind->max_frames = max_frames;
+    rewind->primed = false;
+    return true;
+}
+
+void destroy_rewind(rewind_object *rewind)
+{
+    free(rewind->buffer);
+    free(rewind->record);
+    rewind->buffer = NULL;
+    rewind->record = NULL;
+}
+
+void capture_rewind(rewind_object *rewind, chip8_object *chip8)
+{
+    if (!rewind->primed || rewind->restore_count != chip8->restore_count) {
+        prime_rewind(rewind, chip8);
+        return;
+    }
+
+    uint8_t *record = rewind->record;
+    size_t length = 0;
+
+    memcpy(record, &rewind->registers, sizeof rewind->registers);
+    length += sizeof rewind->registers;
+
+    const size_t ram_words_offset = length;
+    uint16_t ram_words = 0;
+    length += sizeof ram_words;
+
+    for (uint32_t word = 0; word < RAM_DIRTY_WORDS; word++) {
+        const size_t ram_mask_offset = length;
+        uint64_t ram_mask = 0;
+        length += sizeof ram_mask;
+
+        for (uint64_t dirty = chip8->ram_dirty[word]; dirty; dirty &= dirty - 1) {
+            const uint32_t bit = __builtin_ctzll(dirty);
+            const uint32_t offset = (word * 64 + bit) * RAM_BLOCK_SIZE;
+
+            if (memcmp(&chip8->ram[offset], &rewind->ram[offset], RAM_BLOCK_SIZE) == 0) {
+                continue;
+            }
+
+            length += encode_xor_block(&record[length], &chip8->ram[offset], &rewind->ram[offset]);
+            memcpy(&rewind->ram[offset], &chip8->ram[offset], RAM_BLOCK_SIZE);
+            ram_mask |= 1ULL << bit;
+        }
+
+        if (!ram_mask) {
+            length = ram_mask_offset;
+            continue;
+        }
+
+        memcpy(&record[ram_mask_offset], &ram_mask, sizeof ram_mask);
+        ram_words |= 1U << word;
+    }
+
+    memcpy(&record[ram_words_offset], &ram_words, sizeof ram_words);
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        uint64_t row_mask = 0;
+        const size_t row_mask_offset = length;
+        length += sizeof row_mask;
+
+        for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+            uint64_t *current = chip8->display[plane][y];
+            uint64_t *previous = rewind->display[plane][y];
+
+            if (memcmp(current, previous, DISPLAY_ROW_SIZE) == 0) {
+                continue;
+            }
+
+            for (uint8_t word = 0; word < DISPLAY_WORDS; word++) {
+                const uint64_t changed = current[word] ^ previous[word];
+                memcpy(&record[length], &changed, sizeof changed);
+                length += sizeof changed;
+            }
+
+            memcpy(previous, current, DISPLAY_ROW_SIZE);
+            row_mask |= 1ULL << y;
+        }
+
+        memcpy(&record[row_mask_offset], &row_mask, sizeof row_mask);
+    }
+
+    save_registers(&rewind->registers, chip8);
+    clear_ram_dirty(chip8);
+
+    push_record(rewind, record, (uint32_t)length);
+}
+
+bool step_rewind(rewind_object *rewind, chip8_object *chip8)
+{
+    if (!rewind->primed || rewind->restore_count != chip8->restore_count || rewind->frame_count == 0) {
+        return false;
+    }
+
+    uint8_t *record = rewind->record;
+    pop_record(rewind, record);
+    size_t length = 0;
+
+    memcpy(&rewind->registers, record, sizeof rewind->registers);
+    length += sizeof rewind->registers;
+    load_registers(chip8, &rewind->registers);
+
+    uint16_t ram_words = 0;
+    memcpy(&ram_words, &record[length], sizeof ram_words);
+    length += sizeof ram_words;
+
+    for (; ram_words; ram_words &= ram_words - 1) {
+        const uint32_t word = __builtin_ctz(ram_words);
+        uint64_t ram_mask = 0;
+        memcpy(&ram_mask, &record[length], sizeof ram_mask);
+        length += sizeof ram_mask;
+
+        for (; ram_mask; ram_mask &= ram_mask - 1) {
+            const uint32_t offset = (word * 64 + __builtin_ctzll(ram_mask)) * RAM_BLOCK_SIZE;
+            length += apply_xor_block(&record[length], &chip8->ram[offset], &rewind->ram[offset]);
+        }
+    }
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        uint64_t row_mask = 0;
+        memcpy(&row_mask, &record[length], sizeof row_mask);
+        length += sizeof row_mask;
+
+        for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+            if (!(row_mask & (1ULL << y))) {
+                continue;
+            }
+
+            for (uint8_t word = 0; word < DISPLAY_WORDS; word++) {
+                uint64_t changed = 0;
+                memcpy(&changed, &record[length], sizeof changed);
+                length += sizeof changed;
+
+                chip8->display[plane][y][word] ^= changed;
+                rewind->display[plane][y][word] ^= changed;
+            }
+        }
+
+        chip8->dirty_rows |= row_mask;
+    }
+    clear_ram_dirty(chip8);
+    chip8->restore_count++;
+    rewind->restore_count = chip8->restore_count;
+    return true;
+}
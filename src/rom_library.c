@@ -0,0 +1,447 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chip8.h"
+#include "rom_library.h"
+
+#define ARCHIVE_HEADER_SIZE 9
+#define ARCHIVE_ENTRY_SIZE (8 + 4 + 4 + 4 + ROM_QUIRKS_LENGTH + ROM_NAME_LENGTH)
+
+static const uint8_t archive_magic[4] = {'C', '8', 'R', 'L'};
+static const char *rom_extensions[] = {".ch8", ".c8", ".sc8", ".xo8"};
+
+uint64_t hash_rom(const uint8_t *data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (size_t index = 0; index < size; index++) {
+        hash ^= data[index];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+bool map_rom_file(rom_mapping_object *mapping, const char *path)
+{
+    const int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) {
+        fprintf(stderr, "Rom file %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode)) {
+        fprintf(stderr, "Rom file %s is invalid or does not exist\n", path);
+        close(descriptor);
+        return false;
+    }
+
+    if (status.st_size == 0) {
+        fprintf(stderr, "Could not read rom file\n");
+        close(descriptor);
+        return false;
+    }
+
+    mapping->size = (size_t)status.st_size;
+    mapping->address = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    close(descriptor);
+
+    if (mapping->address == MAP_FAILED) {
+        fprintf(stderr, "Could not map rom file %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+void unmap_rom_file(rom_mapping_object *mapping)
+{
+    munmap(mapping->address, mapping->size);
+}
+
+static const char *base_name(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static bool add_mapping(rom_library_object *library, const rom_mapping_object *mapping)
+{
+    rom_mapping_object *mappings = realloc(library->mappings, (library->mapping_count + 1) * sizeof *mappings);
+
+    if (!mappings) {
+        fprintf(stderr, "Could not allocate rom library\n");
+        return false;
+    }
+
+    library->mappings = mappings;
+    library->mappings[library->mapping_count++] = *mapping;
+    return true;
+}
+
+static rom_entry_object *add_entry(rom_library_object *library, const uint8_t *data, uint32_t size, const char *name)
+{
+    rom_entry_object *entries = realloc(library->entries, (library->count + 1) * sizeof *entries);
+
+    if (!entries) {
+        fprintf(stderr, "Could not allocate rom library\n");
+        return NULL;
+    }
+
+    library->entries = entries;
+    rom_entry_object *entry = &library->entries[library->count++];
+    *entry = (rom_entry_object){.hash = hash_rom(data, size), .data = data, .size = size};
+    snprintf(entry->name, sizeof entry->name, "%s", name);
+    return entry;
+}
+
+static bool has_rom_extension(const char *name)
+{
+    const char *extension = strrchr(name, '.');
+
+    if (!extension) {
+        return false;
+    }
+
+    for (size_t index = 0; index < sizeof rom_extensions / sizeof *rom_extensions; index++) {
+        if (strcmp(extension, rom_extensions[index]) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool add_rom_file(rom_library_object *library, const char *path)
+{
+    rom_mapping_object mapping;
+
+    if (!map_rom_file(&mapping, path)) {
+        return false;
+    }
+
+    if (mapping.size > MAX_ROM_SIZE) {
+        fprintf(stderr, "Rom file %s is too big!\n", path);
+        unmap_rom_file(&mapping);
+        return false;
+    }
+
+    if (!add_mapping(library, &mapping)) {
+        unmap_rom_file(&mapping);
+        return false;
+    }
+
+    return add_entry(library, mapping.address, (uint32_t)mapping.size, base_name(path)) != NULL;
+}
+
+static bool open_directory(rom_library_object *library, const char *path)
+{
+    DIR *directory = opendir(path);
+    if (!directory) {
+        fprintf(stderr, "Rom library %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    char file_path[1024];
+    struct dirent *item;
+
+    while ((item = readdir(directory))) {
+        if (item->d_name[0] == '.' || !has_rom_extension(item->d_name)) {
+            continue;
+        }
+
+        snprintf(file_path, sizeof file_path, "%s/%s", path, item->d_name);
+
+        if (!add_rom_file(library, file_path)) {
+            fprintf(stderr, "Skipping %s\n", file_path);
+        }
+    }
+
+    closedir(directory);
+
+    snprintf(file_path, sizeof file_path, "%s/%s", path, ROM_LIBRARY_METADATA);
+    return access(file_path, F_OK) != 0 || load_rom_metadata(library, file_path);
+}
+
+static uint32_t get_u32(const uint8_t *bytes)
+{
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t *bytes)
+{
+    return get_u32(bytes) | ((uint64_t)get_u32(bytes + 4) << 32);
+}
+
+static bool open_archive(rom_library_object *library, const rom_mapping_object *mapping, const char *path)
+{
+    const uint8_t *archive = mapping->address;
+
+    if (mapping->size < ARCHIVE_HEADER_SIZE || archive[4] != ROM_ARCHIVE_VERSION) {
+        fprintf(stderr, "Rom archive %s has an unsupported version\n", path);
+        return false;
+    }
+
+    const uint32_t count = get_u32(archive + 5);
+
+    if ((mapping->size - ARCHIVE_HEADER_SIZE) / ARCHIVE_ENTRY_SIZE < count) {
+        fprintf(stderr, "Rom archive %s is truncated or corrupt\n", path);
+        return false;
+    }
+
+    for (uint32_t index = 0; index < count; index++) {
+        const uint8_t *record = archive + ARCHIVE_HEADER_SIZE + (size_t)index * ARCHIVE_ENTRY_SIZE;
+        const uint32_t offset = get_u32(record + 8);
+        const uint32_t size = get_u32(record + 12);
+
+        if (size > MAX_ROM_SIZE || offset > mapping->size || mapping->size - offset < size) {
+            fprintf(stderr, "Rom archive %s is truncated or corrupt\n", path);
+            return false;
+        }
+
+        char name[ROM_NAME_LENGTH + 1] = {0};
+        memcpy(name, record + 20 + ROM_QUIRKS_LENGTH, ROM_NAME_LENGTH);
+
+        rom_entry_object *entry = add_entry(library, archive + offset, size, name);
+
+        if (!entry) {
+            return false;
+        }
+
+        if (entry->hash != get_u64(record)) {
+            fprintf(stderr, "Rom %s in archive %s does not match its hash\n", name, path);
+            return false;
+        }
+
+        entry->metadata.instructions_per_second = get_u32(record + 16);
+        memcpy(entry->metadata.quirks, record + 20, ROM_QUIRKS_LENGTH - 1);
+    }
+
+    return true;
+}
+
+static int compare_entries(const void *first, const void *second)
+{
+    const rom_entry_object *left = first;
+    const rom_entry_object *right = second;
+
+    if (left->hash != right->hash) {
+        return left->hash < right->hash ? -1 : 1;
+    }
+
+    return strcmp(left->name, right->name);
+}
+
+bool open_rom_library(rom_library_object *library, const char *path)
+{
+    *library = (rom_library_object){0};
+
+    struct stat status;
+    bool opened = false;
+
+    if (stat(path, &status) == 0 && S_ISDIR(status.st_mode)) {
+        opened = open_directory(library, path);
+    } else {
+        rom_mapping_object mapping;
+
+        if (!map_rom_file(&mapping, path)) {
+            return false;
+        }
+
+        opened = add_mapping(library, &mapping);
+
+        if (!opened) {
+            unmap_rom_file(&mapping);
+        } else if (mapping.size >= sizeof archive_magic && memcmp(mapping.address, archive_magic, sizeof archive_magic) == 0) {
+            opened = open_archive(library, &mapping, path);
+        } else if (mapping.size > MAX_ROM_SIZE) {
+            fprintf(stderr, "Rom file %s is too big!\n", path);
+            opened = false;
+        } else {
+            opened = add_entry(library, mapping.address, (uint32_t)mapping.size, base_name(path)) != NULL;
+        }
+    }
+
+    if (!opened) {
+        close_rom_library(library);
+        return false;
+    }
+
+    qsort(library->entries, library->count, sizeof *library->entries, compare_entries);
+    return true;
+}
+
+void close_rom_library(rom_library_object *library)
+{
+    for (size_t index = 0; index < library->mapping_count; index++) {
+        unmap_rom_file(&library->mappings[index]);
+    }
+
+    free(library->mappings);
+    free(library->entries);
+    *library = (rom_library_object){0};
+}
+
+static bool parse_hash(const char *text, uint64_t *hash)
+{
+    char *end = NULL;
+
+    if (strlen(text) != 16) {
+        return false;
+    }
+
+    *hash = strtoull(text, &end, 16);
+    return *end == '\0';
+}
+
+static rom_entry_object *find_hash(const rom_library_object *library, uint64_t hash)
+{
+    size_t low = 0;
+    size_t high = library->count;
+
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+
+        if (library->entries[middle].hash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low < library->count && library->entries[low].hash == hash ? &library->entries[low] : NULL;
+}
+
+bool load_rom_metadata(rom_library_object *library, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Rom metadata %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    qsort(library->entries, library->count, sizeof *library->entries, compare_entries);
+
+    char line[256];
+    uint32_t line_number = 0;
+
+    while (fgets(line, sizeof line, file)) {
+        line_number++;
+
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        char hash_text[32] = {0};
+        unsigned long instructions_per_second = 0;
+        char quirks[ROM_QUIRKS_LENGTH] = {0};
+        const int fields = sscanf(line, "%31s %lu %15s", hash_text, &instructions_per_second, quirks);
+        uint64_t hash = 0;
+
+        if (fields <= 0) {
+            continue;
+        }
+
+        if (fields < 2 || !parse_hash(hash_text, &hash)) {
+            fprintf(stderr, "Invalid metadata line %u in %s\n", line_number, path);
+            fclose(file);
+            return false;
+        }
+
+        for (rom_entry_object *entry = find_hash(library, hash);
+             entry && entry < library->entries + library->count && entry->hash == hash;
+             entry++) {
+            entry->metadata.instructions_per_second = (uint32_t)instructions_per_second;
+            memcpy(entry->metadata.quirks, quirks, sizeof entry->metadata.quirks);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+const rom_entry_object *find_rom(const rom_library_object *library, const char *key)
+{
+    uint64_t hash = 0;
+
+    if (parse_hash(key, &hash)) {
+        const rom_entry_object *entry = find_hash(library, hash);
+
+        if (entry) {
+            return entry;
+        }
+    }
+
+    const char *name = base_name(key);
+
+    for (size_t index = 0; index < library->count; index++) {
+        if (strcmp(library->entries[index].name, name) == 0) {
+            return &library->entries[index];
+        }
+    }
+
+    return NULL;
+}
+
+static void write_u32(FILE *file, uint32_t value)
+{
+    const uint8_t bytes[4] = {value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24};
+    fwrite(bytes, sizeof bytes, 1, file);
+}
+
+bool pack_rom_library(const rom_library_object *library, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open rom archive %s\n", path);
+        return false;
+    }
+
+    fwrite(archive_magic, sizeof archive_magic, 1, file);
+    fputc(ROM_ARCHIVE_VERSION, file);
+    write_u32(file, (uint32_t)library->count);
+
+    uint32_t offset = ARCHIVE_HEADER_SIZE + (uint32_t)library->count * ARCHIVE_ENTRY_SIZE;
+
+    for (size_t index = 0; index < library->count; index++) {
+        const rom_entry_object *entry = &library->entries[index];
+        char quirks[ROM_QUIRKS_LENGTH] = {0};
+        char name[ROM_NAME_LENGTH] = {0};
+
+        memcpy(quirks, entry->metadata.quirks, sizeof quirks - 1);
+        memcpy(name, entry->name, sizeof name - 1);
+
+        write_u32(file, (uint32_t)entry->hash);
+        write_u32(file, (uint32_t)(entry->hash >> 32));
+        write_u32(file, offset);
+        write_u32(file, entry->size);
+        write_u32(file, entry->metadata.instructions_per_second);
+        fwrite(quirks, sizeof quirks, 1, file);
+        fwrite(name, sizeof name, 1, file);
+        offset += entry->size;
+    }
+
+    for (size_t index = 0; index < library->count; index++) {
+        fwrite(library->entries[index].data, library->entries[index].size, 1, file);
+    }
+
+    const bool write_success = !ferror(file);
+    fclose(file);
+
+    if (!write_success) {
+        fprintf(stderr, "Could not write rom archive %s\n", path);
+    }
+
+    return write_success;
+}
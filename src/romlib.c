@@ -0,0 +1,59 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rom_library.h"
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: %s <rom directory | archive | rom> [--metadata FILE] [--pack ARCHIVE]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    const char *metadata = NULL;
+    const char *pack = NULL;
+
+    for (int index = 2; index < argc; index++) {
+        if (strcmp(argv[index], "--metadata") == 0 && index + 1 < argc) {
+            metadata = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--pack") == 0 && index + 1 < argc) {
+            pack = argv[++index];
+            continue;
+        }
+
+        printf("Unknown option %s\n", argv[index]);
+        exit(EXIT_FAILURE);
+    }
+
+    rom_library_object library;
+
+    if (!open_rom_library(&library, argv[1])) {
+        exit(EXIT_FAILURE);
+    }
+
+    if (metadata && !load_rom_metadata(&library, metadata)) {
+        close_rom_library(&library);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t index = 0; index < library.count; index++) {
+        const rom_entry_object *entry = &library.entries[index];
+
+        printf("%016" PRIx64 " %5u %6u %-8s %s\n",
+            entry->hash,
+            entry->size,
+            entry->metadata.instructions_per_second,
+            entry->metadata.quirks[0] ? entry->metadata.quirks : "-",
+            entry->name);
+    }
+
+    const bool packed = !pack || pack_rom_library(&library, pack);
+    close_rom_library(&library);
+
+    exit(packed ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,83 @@
+#include "scheduler.h"
+
+#define MIN_SPIN_MS 1
+#define MAX_SPIN_MS 4
+
+static uint64_t frame_deadline(const scheduler_object *scheduler, uint64_t frame)
+{
+    return scheduler->origin + frame * scheduler->frequency / WINDOW_HERTZ;
+}
+
+static uint64_t clamp_spin(const scheduler_object *scheduler, uint64_t spin_ticks)
+{
+    const uint64_t min_ticks = scheduler->frequency * MIN_SPIN_MS / 1000;
+    const uint64_t max_ticks = scheduler->frequency * MAX_SPIN_MS / 1000;
+
+    if (spin_ticks < min_ticks) {
+        return min_ticks;
+    }
+
+    return spin_ticks > max_ticks ? max_ticks : spin_ticks;
+}
+
+void init_scheduler(scheduler_object *scheduler)
+{
+    scheduler->frequency = SDL_GetPerformanceFrequency();
+    scheduler->spin_ticks = clamp_spin(scheduler, 0);
+    scheduler->missed = 0;
+    reset_scheduler(scheduler);
+}
+
+void reset_scheduler(scheduler_object *scheduler)
+{
+    scheduler->origin = SDL_GetPerformanceCounter();
+    scheduler->frame = 0;
+}
+
+bool wait_next_frame(scheduler_object *scheduler, bool idle)
+{
+    const uint64_t deadline = frame_deadline(scheduler, ++scheduler->frame);
+    uint64_t now = SDL_GetPerformanceCounter();
+
+    if (now > deadline) {
+        const uint64_t late = now - deadline;
+
+        if (late * WINDOW_HERTZ >= scheduler->frequency) {
+            scheduler->missed++;
+            SDL_Log("Missed frame deadline by %.2f ms (%llu missed)\n",
+                late * 1000.0 / scheduler->frequency,
+                (unsigned long long)scheduler->missed);
+            reset_scheduler(scheduler);
+            return false;
+        }
+
+        return true;
+    }
+
+    if (idle) {
+        const uint64_t ticks_per_ms = scheduler->frequency / 1000;
+        SDL_Delay((uint32_t)((deadline - now + ticks_per_ms - 1) / ticks_per_ms));
+        return true;
+    }
+
+    if (deadline - now > scheduler->spin_ticks) {
+        const uint64_t sleep_ticks = deadline - now - scheduler->spin_ticks;
+        const uint32_t sleep_ms = (uint32_t)(sleep_ticks * 1000 / scheduler->frequency);
+
+        if (sleep_ms > 0) {
+            SDL_Delay(sleep_ms);
+
+            const uint64_t woke = SDL_GetPerformanceCounter();
+            const uint64_t expected = now + sleep_ms * scheduler->frequency / 1000;
+            const uint64_t oversleep = woke > expected ? woke - expected : 0;
+
+            scheduler->spin_ticks = clamp_spin(scheduler, (scheduler->spin_ticks * 7 + oversleep * 2) / 8);
+        }
+    }
+
+    do {
+        now = SDL_GetPerformanceCounter();
+    } while (now < deadline);
+
+    return true;
+}
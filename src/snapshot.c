@@ -0,0 +1,406 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "rom_library.h"
+#include "snapshot.h"
+
+#define RUN_MERGE_GAP 4
+
+static const uint8_t snapshot_magic[4] = {'C', '8', 'S', 'S'};
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    size_t used;
+    bool overflow;
+} writer_object;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t used;
+    bool overflow;
+} reader_object;
+
+static void put_bytes(writer_object *writer, const void *bytes, size_t length)
+{
+    if (writer->overflow || writer->size - writer->used < length) {
+        writer->overflow = true;
+        return;
+    }
+
+    memcpy(writer->data + writer->used, bytes, length);
+    writer->used += length;
+}
+
+static void put_u8(writer_object *writer, uint8_t value)
+{
+    put_bytes(writer, &value, 1);
+}
+
+static void put_u16(writer_object *writer, uint16_t value)
+{
+    const uint8_t bytes[2] = {value & 0xFF, value >> 8};
+    put_bytes(writer, bytes, sizeof bytes);
+}
+
+static void put_u32(writer_object *writer, uint32_t value)
+{
+    put_u16(writer, value & 0xFFFF);
+    put_u16(writer, value >> 16);
+}
+
+static void put_u64(writer_object *writer, uint64_t value)
+{
+    put_u32(writer, value & 0xFFFFFFFF);
+    put_u32(writer, value >> 32);
+}
+
+static const uint8_t *get_bytes(reader_object *reader, size_t length)
+{
+    if (reader->overflow || reader->size - reader->used < length) {
+        reader->overflow = true;
+        return NULL;
+    }
+
+    const uint8_t *bytes = reader->data + reader->used;
+    reader->used += length;
+    return bytes;
+}
+
+static uint8_t get_u8(reader_object *reader)
+{
+    const uint8_t *bytes = get_bytes(reader, 1);
+    return bytes ? bytes[0] : 0;
+}
+
+static uint16_t get_u16(reader_object *reader)
+{
+    const uint8_t *bytes = get_bytes(reader, 2);
+    return bytes ? (uint16_t)(bytes[0] | (bytes[1] << 8)) : 0;
+}
+
+static uint32_t get_u32(reader_object *reader)
+{
+    const uint32_t low = get_u16(reader);
+    return low | ((uint32_t)get_u16(reader) << 16);
+}
+
+static uint64_t get_u64(reader_object *reader)
+{
+    const uint64_t low = get_u32(reader);
+    return low | ((uint64_t)get_u32(reader) << 32);
+}
+
+static void put_header(writer_object *writer, snapshot_kind kind, const chip8_object *chip8)
+{
+    put_bytes(writer, snapshot_magic, sizeof snapshot_magic);
+    put_u8(writer, SNAPSHOT_VERSION);
+    put_u8(writer, kind);
+    put_u8(writer, chip8->quirks);
+    put_u64(writer, chip8->rom_hash);
+}
+
+static uint64_t hash_base(const chip8_object *chip8)
+{
+    return hash_rom(chip8->ram, sizeof chip8->ram) ^ (hash_display(chip8) * 0x100000001B3);
+}
+
+static void put_registers(writer_object *writer, const chip8_object *chip8)
+{
+    uint16_t keypad = 0;
+
+    for (uint8_t index = 0; index < sizeof chip8->keypad; index++) {
+        keypad |= (uint16_t)chip8->keypad[index] << index;
+    }
+
+    put_u8(writer, chip8->state);
+    put_u8(writer, (uint8_t)(chip8->stack_pointer - chip8->stack));
+
+    for (uint8_t index = 0; index < sizeof chip8->stack / sizeof chip8->stack[0]; index++) {
+        put_u16(writer, chip8->stack[index]);
+    }
+
+    put_bytes(writer, chip8->V, sizeof chip8->V);
+    put_u16(writer, chip8->I);
+    put_u16(writer, chip8->program_counter);
+    put_u8(writer, chip8->delay_timer);
+    put_u8(writer, chip8->sound_timer);
+    put_u16(writer, keypad);
+    put_u8(writer, chip8->key_pending);
+    put_u8(writer, chip8->pending_key);
+    put_u32(writer, chip8->rng_state);
+    put_u64(writer, chip8->dirty_rows);
+    put_u8(writer, chip8->hires);
+    put_u8(writer, chip8->planes);
+    put_bytes(writer, chip8->rpl, sizeof chip8->rpl);
+}
+
+static void put_display_row(writer_object *writer, const uint64_t row[DISPLAY_WORDS])
+{
+    for (uint8_t word = 0; word < DISPLAY_WORDS; word++) {
+        put_u64(writer, row[word]);
+    }
+}
+
+static void get_display_row(reader_object *reader, uint64_t row[DISPLAY_WORDS])
+{
+    for (uint8_t word = 0; word < DISPLAY_WORDS; word++) {
+        row[word] = get_u64(reader);
+    }
+}
+
+static bool get_registers(reader_object *reader, chip8_object *chip8)
+{
+    const uint8_t state = get_u8(reader);
+    const uint8_t stack_index = get_u8(reader);
+
+    for (uint8_t index = 0; index < sizeof chip8->stack / sizeof chip8->stack[0]; index++) {
+        chip8->stack[index] = get_u16(reader);
+    }
+
+    const uint8_t *V = get_bytes(reader, sizeof chip8->V);
+    chip8->I = get_u16(reader);
+    chip8->program_counter = get_u16(reader);
+    chip8->delay_timer = get_u8(reader);
+    chip8->sound_timer = get_u8(reader);
+    const uint16_t keypad = get_u16(reader);
+    chip8->key_pending = get_u8(reader);
+    chip8->pending_key = get_u8(reader);
+    chip8->rng_state = get_u32(reader);
+    chip8->dirty_rows = get_u64(reader);
+    chip8->hires = get_u8(reader);
+    chip8->planes = get_u8(reader);
+    const uint8_t *rpl = get_bytes(reader, sizeof chip8->rpl);
+
+    if (reader->overflow || state > REWINDING || chip8->pending_key >= sizeof chip8->keypad
+        || stack_index > sizeof chip8->stack / sizeof chip8->stack[0] || chip8->planes >= 1 << DISPLAY_PLANES) {
+        return false;
+    }
+
+    memcpy(chip8->rpl, rpl, sizeof chip8->rpl);
+
+    chip8->state = state;
+    chip8->stack_pointer = &chip8->stack[stack_index];
+    memcpy(chip8->V, V, sizeof chip8->V);
+
+    for (uint8_t index = 0; index < sizeof chip8->keypad; index++) {
+        chip8->keypad[index] = (keypad >> index) & 1;
+    }
+
+    return true;
+}
+
+size_t chip8_snapshot(const chip8_object *chip8, uint8_t *buffer, size_t size)
+{
+    writer_object writer = {.data = buffer, .size = size};
+
+    put_header(&writer, SNAPSHOT_FULL, chip8);
+    put_registers(&writer, chip8);
+    put_bytes(&writer, chip8->ram, sizeof chip8->ram);
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+            put_display_row(&writer, chip8->display[plane][y]);
+        }
+    }
+
+    return writer.overflow ? 0 : writer.used;
+}
+
+size_t chip8_snapshot_delta(const chip8_object *chip8, const chip8_object *previous, uint8_t *buffer, size_t size)
+{
+    writer_object writer = {.data = buffer, .size = size};
+
+    put_header(&writer, SNAPSHOT_DELTA, chip8);
+    put_u64(&writer, hash_base(previous));
+    put_registers(&writer, chip8);
+
+    const size_t run_count_offset = writer.used;
+    uint16_t run_count = 0;
+    put_u16(&writer, 0);
+
+    for (uint32_t address = 0; address < MEMORY_SIZE && !writer.overflow; address++) {
+        if (chip8->ram[address] == previous->ram[address]) {
+            continue;
+        }
+
+        uint32_t end = address + 1;
+        uint32_t unchanged = 0;
+
+        for (uint32_t next = end; next < MEMORY_SIZE && unchanged < RUN_MERGE_GAP; next++) {
+            if (chip8->ram[next] == previous->ram[next]) {
+                unchanged++;
+                continue;
+            }
+
+            end = next + 1;
+            unchanged = 0;
+        }
+
+        put_u16(&writer, address);
+        put_u32(&writer, end - address);
+        put_bytes(&writer, &chip8->ram[address], end - address);
+        run_count++;
+        address = end;
+    }
+
+    if (!writer.overflow) {
+        writer.data[run_count_offset] = run_count & 0xFF;
+        writer.data[run_count_offset + 1] = run_count >> 8;
+    }
+
+    for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+        uint64_t changed_rows = 0;
+
+        for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+            changed_rows |= (uint64_t)(memcmp(chip8->display[plane][y], previous->display[plane][y], sizeof chip8->display[plane][y]) != 0) << y;
+        }
+
+        put_u64(&writer, changed_rows);
+
+        for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+            if (changed_rows & (1ULL << y)) {
+                put_display_row(&writer, chip8->display[plane][y]);
+            }
+        }
+    }
+
+    if (writer.overflow) {
+        return chip8_snapshot(chip8, buffer, size);
+    }
+
+    return writer.used;
+}
+
+bool chip8_restore(chip8_object *chip8, const uint8_t *buffer, size_t size)
+{
+    reader_object reader = {.data = buffer, .size = size};
+    const uint8_t *magic = get_bytes(&reader, sizeof snapshot_magic);
+    const uint8_t version = get_u8(&reader);
+    const uint8_t kind = get_u8(&reader);
+
+    if (!magic || memcmp(magic, snapshot_magic, sizeof snapshot_magic) != 0) {
+        fprintf(stderr, "Snapshot has an invalid header\n");
+        return false;
+    }
+
+    if (version != SNAPSHOT_VERSION || (kind != SNAPSHOT_FULL && kind != SNAPSHOT_DELTA)) {
+        fprintf(stderr, "Unsupported snapshot version %u kind %u\n", version, kind);
+        return false;
+    }
+
+    const uint8_t quirks = get_u8(&reader);
+    const uint64_t rom_hash = get_u64(&reader);
+
+    if (!reader.overflow && quirks != chip8->quirks) {
+        fprintf(stderr, "Snapshot was saved with quirk profile %s\n",
+            quirks < QUIRKS_COUNT ? quirk_profile_name(quirks) : "unknown");
+        return false;
+    }
+
+    if (!reader.overflow && rom_hash != chip8->rom_hash) {
+        fprintf(stderr, "Snapshot was saved with a different rom\n");
+        return false;
+    }
+
+    if (kind == SNAPSHOT_DELTA && !reader.overflow && get_u64(&reader) != hash_base(chip8)) {
+        fprintf(stderr, "Delta snapshot was taken against a different base state\n");
+        return false;
+    }
+
+    chip8_object restored = *chip8;
+
+    if (!get_registers(&reader, &restored)) {
+        fprintf(stderr, "Snapshot registers are invalid\n");
+        return false;
+    }
+
+    if (kind == SNAPSHOT_FULL) {
+        const uint8_t *ram = get_bytes(&reader, sizeof restored.ram);
+
+        if (ram) {
+            memcpy(restored.ram, ram, sizeof restored.ram);
+        }
+
+        for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+            for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+                get_display_row(&reader, restored.display[plane][y]);
+            }
+        }
+    } else {
+        const uint16_t run_count = get_u16(&reader);
+
+        for (uint16_t run = 0; run < run_count && !reader.overflow; run++) {
+            const uint16_t address = get_u16(&reader);
+            const uint32_t length = get_u32(&reader);
+            const uint8_t *bytes = get_bytes(&reader, length);
+
+            if (!bytes || address + length > MEMORY_SIZE) {
+                reader.overflow = true;
+                break;
+            }
+
+            memcpy(&restored.ram[address], bytes, length);
+        }
+
+        for (uint8_t plane = 0; plane < DISPLAY_PLANES; plane++) {
+            const uint64_t changed_rows = get_u64(&reader);
+
+            for (uint8_t y = 0; y < DISPLAY_HEIGHT; y++) {
+                if (changed_rows & (1ULL << y)) {
+                    get_display_row(&reader, restored.display[plane][y]);
+                }
+            }
+        }
+    }
+
+    if (reader.overflow) {
+        fprintf(stderr, "Snapshot is truncated or corrupt\n");
+        return false;
+    }
+
+    const uint8_t stack_index = (uint8_t)(restored.stack_pointer - restored.stack);
+
+    *chip8 = restored;
+    chip8->stack_pointer = &chip8->stack[stack_index];
+    chip8->restore_count++;
+    return true;
+}
+
+bool save_snapshot_file(const chip8_object *chip8, const char *path)
+{
+    uint8_t buffer[SNAPSHOT_MAX_SIZE];
+    const size_t size = chip8_snapshot(chip8, buffer, sizeof buffer);
+
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Could not open snapshot file %s\n", path);
+        return false;
+    }
+
+    const bool write_success = size > 0 && fwrite(buffer, size, 1, file) == 1;
+    fclose(file);
+
+    if (!write_success) {
+        fprintf(stderr, "Could not write snapshot file %s\n", path);
+    }
+
+    return write_success;
+}
+
+bool load_snapshot_file(chip8_object *chip8, const char *path)
+{
+    uint8_t buffer[SNAPSHOT_MAX_SIZE];
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Snapshot file %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    const size_t size = fread(buffer, 1, sizeof buffer, file);
+    fclose(file);
+
+    return chip8_restore(chip8, buffer, size);
+}
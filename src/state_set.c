@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "state_set.h"
+
+bool init_state_set(state_set_object *set, size_t limit)
+{
+    size_t capacity = 64;
+
+    while (capacity < limit * 2) {
+        capacity *= 2;
+    }
+
+    set->slots = calloc(capacity, sizeof *set->slots);
+
+    if (!set->slots) {
+        fprintf(stderr, "Could not allocate state set with %zu slots\n", capacity);
+        return false;
+    }
+
+    set->mask = capacity - 1;
+    set->limit = limit;
+    atomic_init(&set->count, 0);
+    return true;
+}
+
+void destroy_state_set(state_set_object *set)
+{
+    free(set->slots);
+    set->slots = NULL;
+}
+
+state_insert_result insert_state(state_set_object *set, uint64_t hash)
+{
+    const uint64_t key = hash ? hash : 1;
+
+    for (uint64_t slot = (key ^ (key >> 32)) & set->mask;; slot = (slot + 1) & set->mask) {
+        uint64_t current = atomic_load_explicit(&set->slots[slot], memory_order_relaxed);
+
+        if (current == key) {
+            return STATE_PRESENT;
+        }
+
+        if (current != 0) {
+            continue;
+        }
+
+        if (atomic_fetch_add_explicit(&set->count, 1, memory_order_relaxed) >= set->limit) {
+            atomic_fetch_sub_explicit(&set->count, 1, memory_order_relaxed);
+            return STATE_FULL;
+        }
+
+        if (atomic_compare_exchange_strong_explicit(&set->slots[slot], &current, key,
+                memory_order_relaxed, memory_order_relaxed)) {
+            return STATE_ADDED;
+        }
+
+        atomic_fetch_sub_explicit(&set->count, 1, memory_order_relaxed);
+
+        if (current == key) {
+            return STATE_PRESENT;
+        }
+    }
+}
+
+size_t state_set_size(state_set_object *set)
+{
+    return atomic_load_explicit(&set->count, memory_order_relaxed);
+}
@@ -0,0 +1,122 @@
+#include <string.h>
+
+#include "thread_queue.h"
+
+#define FRESH_FRAME 0x4
+#define FRAME_INDEX 0x3
+
+void init_input_queue(input_queue_object *queue)
+{
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+}
+
+bool push_input(input_queue_object *queue, input_command_object command)
+{
+    const uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+    if (tail - head == INPUT_QUEUE_SIZE) {
+        return false;
+    }
+
+    queue->commands[tail % INPUT_QUEUE_SIZE] = command;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool pop_input(input_queue_object *queue, input_command_object *command)
+{
+    const uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *command = queue->commands[head % INPUT_QUEUE_SIZE];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+void init_audio_ring(audio_ring_object *ring)
+{
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->underruns, 0);
+}
+
+uint32_t audio_ring_fill(audio_ring_object *ring)
+{
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return tail - head;
+}
+
+uint32_t push_audio(audio_ring_object *ring, const int16_t *samples, uint32_t count)
+{
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    const uint32_t space = AUDIO_RING_SIZE - (tail - head);
+
+    if (count > space) {
+        count = space;
+    }
+
+    for (uint32_t index = 0; index < count; index++) {
+        ring->samples[(tail + index) % AUDIO_RING_SIZE] = samples[index];
+    }
+
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    return count;
+}
+
+uint32_t pop_audio(audio_ring_object *ring, int16_t *samples, uint32_t count)
+{
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const uint32_t available = tail - head;
+
+    if (count > available) {
+        atomic_fetch_add_explicit(&ring->underruns, 1, memory_order_relaxed);
+        count = available;
+    }
+
+    for (uint32_t index = 0; index < count; index++) {
+        samples[index] = ring->samples[(head + index) % AUDIO_RING_SIZE];
+    }
+
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return count;
+}
+
+void init_triple_buffer(triple_buffer_object *buffer)
+{
+    memset(buffer->frames, 0, sizeof buffer->frames);
+    buffer->back = 0;
+    atomic_init(&buffer->middle, 1);
+    buffer->front = 2;
+}
+
+frame_object *back_frame(triple_buffer_object *buffer)
+{
+    return &buffer->frames[buffer->back];
+}
+
+bool publish_frame(triple_buffer_object *buffer)
+{
+    const uint32_t previous = atomic_exchange_explicit(&buffer->middle, buffer->back | FRESH_FRAME, memory_order_acq_rel);
+    buffer->back = previous & FRAME_INDEX;
+    return previous & FRESH_FRAME;
+}
+
+const frame_object *acquire_frame(triple_buffer_object *buffer)
+{
+    if (!(atomic_load_explicit(&buffer->middle, memory_order_relaxed) & FRESH_FRAME)) {
+        return NULL;
+    }
+
+    const uint32_t previous = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+    buffer->front = previous & FRAME_INDEX;
+    return &buffer->frames[buffer->front];
+}
@@ -0,0 +1,560 @@
+#include <string.h>
+
+#include "threaded.h"
+
+#define ADDRESS_MASK (MEMORY_SIZE - 1)
+
+#define DISPATCH()                                  \
+    do {                                            \
+        if (remaining-- == 0) {                     \
+            goto done;                              \
+        }                                           \
+        entry = &table[pc & ADDRESS_MASK];          \
+        pc += 2;                                    \
+        goto *handlers[entry->handler];             \
+    } while (0)
+
+enum {
+    OP_DECODE,
+    OP_NOP,
+    OP_CLS,
+    OP_RET,
+    OP_JP,
+    OP_CALL,
+    OP_SE_IMM,
+    OP_SNE_IMM,
+    OP_SE_REG,
+    OP_LD_IMM,
+    OP_ADD_IMM,
+    OP_LD_REG,
+    OP_OR,
+    OP_AND,
+    OP_XOR,
+    OP_ADD_REG,
+    OP_SUB,
+    OP_SHR,
+    OP_SUBN,
+    OP_SHL,
+    OP_SNE_REG,
+    OP_LD_I,
+    OP_JP_V0,
+    OP_RND,
+    OP_DRW,
+    OP_SKP,
+    OP_SKNP,
+    OP_LD_VX_DT,
+    OP_LD_VX_K,
+    OP_LD_DT,
+    OP_LD_ST,
+    OP_ADD_I,
+    OP_LD_F,
+    OP_LD_B,
+    OP_LD_MEM,
+    OP_LD_VX_MEM,
+    OP_OR_KEEP_VF,
+    OP_AND_KEEP_VF,
+    OP_XOR_KEEP_VF,
+    OP_SHR_VX,
+    OP_SHL_VX,
+    OP_JP_VX,
+    OP_DRW_WRAP,
+    OP_LD_MEM_KEEP_I,
+    OP_LD_VX_MEM_KEEP_I,
+    OP_LD_I_LONG,
+    OP_SAVE_RANGE,
+    OP_INTERPRET,
+    OP_COUNT
+};
+
+static uint8_t decode_handler(uint16_t opcode, uint32_t quirks)
+{
+    const uint8_t NN = opcode & 0x0FF;
+    const uint8_t N = opcode & 0x0F;
+    const bool long_skip = quirks & QUIRK_LONG_SKIP;
+
+    switch ((opcode >> 12) & 0x0F)
+    {
+        case 0x00:
+            if (NN == 0xE0) {
+                return OP_CLS;
+            }
+            if (NN == 0xEE) {
+                return OP_RET;
+            }
+            if ((NN & 0xF0) == 0xC0 || (NN & 0xF0) == 0xD0 || NN >= 0xFB) {
+                return OP_INTERPRET;
+            }
+            return OP_NOP;
+
+        case 0x01:
+            return OP_JP;
+
+        case 0x02:
+            return OP_CALL;
+
+        case 0x03:
+            return long_skip ? OP_INTERPRET : OP_SE_IMM;
+
+        case 0x04:
+            return long_skip ? OP_INTERPRET : OP_SNE_IMM;
+
+        case 0x05:
+            switch (N)
+            {
+                case 0:
+                    return long_skip ? OP_INTERPRET : OP_SE_REG;
+                case 2:
+                    return OP_SAVE_RANGE;
+                case 3:
+                    return OP_INTERPRET;
+                default:
+                    return OP_NOP;
+            }
+
+        case 0x06:
+            return OP_LD_IMM;
+
+        case 0x07:
+            return OP_ADD_IMM;
+
+        case 0x08:
+            switch (N)
+            {
+                case 0:
+                    return OP_LD_REG;
+                case 1:
+                    return (quirks & QUIRK_VF_RESET) ? OP_OR : OP_OR_KEEP_VF;
+                case 2:
+                    return (quirks & QUIRK_VF_RESET) ? OP_AND : OP_AND_KEEP_VF;
+                case 3:
+                    return (quirks & QUIRK_VF_RESET) ? OP_XOR : OP_XOR_KEEP_VF;
+                case 4:
+                    return OP_ADD_REG;
+                case 5:
+                    return OP_SUB;
+                case 6:
+                    return (quirks & QUIRK_SHIFT_VX) ? OP_SHR_VX : OP_SHR;
+                case 7:
+                    return OP_SUBN;
+                case 0xE:
+                    return (quirks & QUIRK_SHIFT_VX) ? OP_SHL_VX : OP_SHL;
+                default:
+                    return OP_NOP;
+            }
+
+        case 0x09:
+            return long_skip ? OP_INTERPRET : OP_SNE_REG;
+
+        case 0x0A:
+            return OP_LD_I;
+
+        case 0x0B:
+            return (quirks & QUIRK_JUMP_VX) ? OP_JP_VX : OP_JP_V0;
+
+        case 0x0C:
+            return OP_RND;
+
+        case 0x0D:
+            return (quirks & QUIRK_CLIPPING) ? OP_DRW : OP_DRW_WRAP;
+
+        case 0x0E:
+            if (NN == 0x9E) {
+                return long_skip ? OP_INTERPRET : OP_SKP;
+            }
+            if (NN == 0xA1) {
+                return long_skip ? OP_INTERPRET : OP_SKNP;
+            }
+            return OP_NOP;
+
+        case 0x0F:
+            switch (NN)
+            {
+                case 0x00:
+                    return opcode == 0xF000 ? OP_LD_I_LONG : OP_NOP;
+                case 0x01:
+                case 0x30:
+                case 0x75:
+                case 0x85:
+                    return OP_INTERPRET;
+                case 0x07:
+                    return OP_LD_VX_DT;
+                case 0x0A:
+                    return OP_LD_VX_K;
+                case 0x15:
+                    return OP_LD_DT;
+                case 0x18:
+                    return OP_LD_ST;
+                case 0x1E:
+                    return OP_ADD_I;
+                case 0x29:
+                    return OP_LD_F;
+                case 0x33:
+                    return OP_LD_B;
+                case 0x55:
+                    return (quirks & QUIRK_MEMORY_INCREMENT) ? OP_LD_MEM : OP_LD_MEM_KEEP_I;
+                case 0x65:
+                    return (quirks & QUIRK_MEMORY_INCREMENT) ? OP_LD_VX_MEM : OP_LD_VX_MEM_KEEP_I;
+                default:
+                    return OP_NOP;
+            }
+
+        default:
+            return OP_NOP;
+    }
+}
+
+static void decode_instruction(decoded_object *entry, const chip8_object *chip8, uint16_t address)
+{
+    const uint16_t opcode = (chip8->ram[address & ADDRESS_MASK] << 8) | chip8->ram[(address + 1) & ADDRESS_MASK];
+
+    entry->handler = decode_handler(opcode, quirk_flags(chip8->quirks));
+    entry->NNN = opcode & 0x0FFF;
+    entry->NN = opcode & 0x0FF;
+    entry->X = (opcode >> 8) & 0x0F;
+    entry->Y = (opcode >> 4) & 0x0F;
+}
+
+static void invalidate_range(threaded_object *threaded, uint16_t first, uint32_t length)
+{
+    for (uint32_t offset = 0; offset <= length; offset++) {
+        threaded->table[(first + MEMORY_SIZE - 1 + offset) & ADDRESS_MASK].handler = OP_DECODE;
+    }
+}
+
+void reset_threaded(threaded_object *threaded)
+{
+    memset(threaded->table, 0, sizeof threaded->table);
+}
+
+void run_threaded(threaded_object *threaded, chip8_object *chip8, uint32_t count)
+{
+    static void *const handlers[OP_COUNT] = {
+        [OP_DECODE] = &&op_decode,
+        [OP_NOP] = &&op_nop,
+        [OP_CLS] = &&op_cls,
+        [OP_RET] = &&op_ret,
+        [OP_JP] = &&op_jp,
+        [OP_CALL] = &&op_call,
+        [OP_SE_IMM] = &&op_se_imm,
+        [OP_SNE_IMM] = &&op_sne_imm,
+        [OP_SE_REG] = &&op_se_reg,
+        [OP_LD_IMM] = &&op_ld_imm,
+        [OP_ADD_IMM] = &&op_add_imm,
+        [OP_LD_REG] = &&op_ld_reg,
+        [OP_OR] = &&op_or,
+        [OP_AND] = &&op_and,
+        [OP_XOR] = &&op_xor,
+        [OP_ADD_REG] = &&op_add_reg,
+        [OP_SUB] = &&op_sub,
+        [OP_SHR] = &&op_shr,
+        [OP_SUBN] = &&op_subn,
+        [OP_SHL] = &&op_shl,
+        [OP_SNE_REG] = &&op_sne_reg,
+        [OP_LD_I] = &&op_ld_i,
+        [OP_JP_V0] = &&op_jp_v0,
+        [OP_RND] = &&op_rnd,
+        [OP_DRW] = &&op_drw,
+        [OP_SKP] = &&op_skp,
+        [OP_SKNP] = &&op_sknp,
+        [OP_LD_VX_DT] = &&op_ld_vx_dt,
+        [OP_LD_VX_K] = &&op_ld_vx_k,
+        [OP_LD_DT] = &&op_ld_dt,
+        [OP_LD_ST] = &&op_ld_st,
+        [OP_ADD_I] = &&op_add_i,
+        [OP_LD_F] = &&op_ld_f,
+        [OP_LD_B] = &&op_ld_b,
+        [OP_LD_MEM] = &&op_ld_mem,
+        [OP_LD_VX_MEM] = &&op_ld_vx_mem,
+        [OP_OR_KEEP_VF] = &&op_or_keep_vf,
+        [OP_AND_KEEP_VF] = &&op_and_keep_vf,
+        [OP_XOR_KEEP_VF] = &&op_xor_keep_vf,
+        [OP_SHR_VX] = &&op_shr_vx,
+        [OP_SHL_VX] = &&op_shl_vx,
+        [OP_JP_VX] = &&op_jp_vx,
+        [OP_DRW_WRAP] = &&op_drw_wrap,
+        [OP_LD_MEM_KEEP_I] = &&op_ld_mem_keep_i,
+        [OP_LD_VX_MEM_KEEP_I] = &&op_ld_vx_mem_keep_i,
+        [OP_LD_I_LONG] = &&op_ld_i_long,
+        [OP_SAVE_RANGE] = &&op_save_range,
+        [OP_INTERPRET] = &&op_interpret,
+    };
+
+    if (threaded->quirks != chip8->quirks) {
+        reset_threaded(threaded);
+        threaded->quirks = chip8->quirks;
+    }
+
+    decoded_object *const table = threaded->table;
+    uint8_t *const V = chip8->V;
+    uint16_t pc = chip8->program_counter;
+    uint32_t remaining = count;
+    decoded_object *entry;
+    bool positive_result;
+
+    DISPATCH();
+
+op_decode:
+    decode_instruction(entry, chip8, pc - 2);
+    goto *handlers[entry->handler];
+
+op_nop:
+    DISPATCH();
+
+op_cls:
+    clear_display(chip8);
+    DISPATCH();
+
+op_ret:
+    pc = *--chip8->stack_pointer;
+    DISPATCH();
+
+op_jp:
+    pc = entry->NNN;
+    DISPATCH();
+
+op_call:
+    *chip8->stack_pointer++ = pc;
+    pc = entry->NNN;
+    DISPATCH();
+
+op_se_imm:
+    if (V[entry->X] == entry->NN) {
+        pc += 2;
+    }
+    DISPATCH();
+
+op_sne_imm:
+    if (V[entry->X] != entry->NN) {
+        pc += 2;
+    }
+    DISPATCH();
+
+op_se_reg:
+    if (V[entry->X] == V[entry->Y]) {
+        pc += 2;
+    }
+    DISPATCH();
+
+op_ld_imm:
+    V[entry->X] = entry->NN;
+    DISPATCH();
+
+op_add_imm:
+    V[entry->X] += entry->NN;
+    DISPATCH();
+
+op_ld_reg:
+    V[entry->X] = V[entry->Y];
+    DISPATCH();
+
+op_or:
+    V[entry->X] |= V[entry->Y];
+    V[0xF] = 0;
+    DISPATCH();
+
+op_and:
+    V[entry->X] &= V[entry->Y];
+    V[0xF] = 0;
+    DISPATCH();
+
+op_xor:
+    V[entry->X] ^= V[entry->Y];
+    V[0xF] = 0;
+    DISPATCH();
+
+op_add_reg:
+    positive_result = ((uint16_t)(V[entry->X] + V[entry->Y]) > 255);
+    V[entry->X] += V[entry->Y];
+    V[0xF] = positive_result;
+    DISPATCH();
+
+op_sub:
+    positive_result = (V[entry->Y] <= V[entry->X]);
+    V[entry->X] -= V[entry->Y];
+    V[0xF] = positive_result;
+    DISPATCH();
+
+op_shr:
+    positive_result = V[entry->Y] & 1;
+    V[entry->X] = V[entry->Y] >> 1;
+    V[0xF] = positive_result;
+    DISPATCH();
+
+op_subn:
+    positive_result = (V[entry->X] <= V[entry->Y]);
+    V[entry->X] = V[entry->Y] - V[entry->X];
+    V[0xF] = positive_result;
+    DISPATCH();
+
+op_shl:
+    positive_result = (V[entry->Y] & 0x80) >> 7;
+    V[entry->X] = V[entry->Y] << 1;
+    V[0xF] = positive_result;
+    DISPATCH();
+
+op_sne_reg:
+    if (V[entry->X] != V[entry->Y]) {
+        pc += 2;
+    }
+    DISPATCH();
+
+op_ld_i:
+    chip8->I = entry->NNN;
+    DISPATCH();
+
+op_jp_v0:
+    pc = V[0] + entry->NNN;
+    DISPATCH();
+
+op_rnd:
+    V[entry->X] = random_byte(chip8) & entry->NN;
+    DISPATCH();
+
+op_drw:
+    draw_sprite(chip8, V[entry->X], V[entry->Y], entry->NN & 0x0F);
+    DISPATCH();
+
+op_skp:
+    if (chip8->keypad[V[entry->X]]) {
+        pc += 2;
+    }
+    DISPATCH();
+
+op_sknp:
+    if (!chip8->keypad[V[entry->X]]) {
+        pc += 2;
+    }
+    DISPATCH();
+
+op_ld_vx_dt:
+    V[entry->X] = chip8->delay_timer;
+    DISPATCH();
+
+op_ld_vx_k:
+    chip8->program_counter = pc - 2;
+    emulate_instruction(chip8);
+    pc = chip8->program_counter;
+    DISPATCH();
+
+op_ld_dt:
+    chip8->delay_timer = V[entry->X];
+    DISPATCH();
+
+op_ld_st:
+    chip8->sound_timer = V[entry->X];
+    DISPATCH();
+
+op_add_i:
+    chip8->I += V[entry->X];
+    DISPATCH();
+
+op_ld_f:
+    chip8->I = V[entry->X] * 5;
+    DISPATCH();
+
+op_ld_b: {
+    uint8_t bcd = V[entry->X];
+
+    chip8->ram[(uint16_t)(chip8->I + 2)] = bcd % 10;
+    bcd /= 10;
+    chip8->ram[(uint16_t)(chip8->I + 1)] = bcd % 10;
+    bcd /= 10;
+    chip8->ram[chip8->I] = bcd;
+
+    mark_ram_dirty(chip8, chip8->I, chip8->I + 2);
+    invalidate_range(threaded, chip8->I, 3);
+    DISPATCH();
+}
+
+op_ld_mem: {
+    const uint16_t first = chip8->I;
+
+    for (uint8_t index = 0; index <= entry->X; index++) {
+        chip8->ram[chip8->I++] = V[index];
+    }
+
+    mark_ram_dirty(chip8, first, first + entry->X);
+    invalidate_range(threaded, first, entry->X + 1);
+    DISPATCH();
+}
+
+op_ld_vx_mem:
+    for (uint8_t index = 0; index <= entry->X; index++) {
+        V[index] = chip8->ram[chip8->I++];
+    }
+    DISPATCH();
+
+op_or_keep_vf:
+    V[entry->X] |= V[entry->Y];
+    DISPATCH();
+
+op_and_keep_vf:
+    V[entry->X] &= V[entry->Y];
+    DISPATCH();
+
+op_xor_keep_vf:
+    V[entry->X] ^= V[entry->Y];
+    DISPATCH();
+
+op_shr_vx:
+    positive_result = V[entry->X] & 1;
+    V[entry->X] >>= 1;
+    V[0xF] = positive_result;
+    DISPATCH();
+
+op_shl_vx:
+    positive_result = (V[entry->X] & 0x80) >> 7;
+    V[entry->X] <<= 1;
+    V[0xF] = positive_result;
+    DISPATCH();
+
+op_jp_vx:
+    pc = V[entry->X] + entry->NNN;
+    DISPATCH();
+
+op_drw_wrap:
+    draw_sprite_wrapped(chip8, V[entry->X], V[entry->Y], entry->NN & 0x0F);
+    DISPATCH();
+
+op_ld_mem_keep_i:
+    for (uint8_t index = 0; index <= entry->X; index++) {
+        chip8->ram[(uint16_t)(chip8->I + index)] = V[index];
+    }
+
+    mark_ram_dirty(chip8, chip8->I, chip8->I + entry->X);
+    invalidate_range(threaded, chip8->I, entry->X + 1);
+    DISPATCH();
+
+op_ld_vx_mem_keep_i:
+    for (uint8_t index = 0; index <= entry->X; index++) {
+        V[index] = chip8->ram[(uint16_t)(chip8->I + index)];
+    }
+    DISPATCH();
+
+op_ld_i_long:
+    chip8->I = (chip8->ram[pc] << 8) | chip8->ram[(uint16_t)(pc + 1)];
+    pc += 2;
+    DISPATCH();
+
+op_save_range: {
+    const uint8_t distance = entry->X < entry->Y ? entry->Y - entry->X : entry->X - entry->Y;
+    const int8_t direction = entry->X < entry->Y ? 1 : -1;
+
+    for (uint8_t index = 0; index <= distance; index++) {
+        chip8->ram[(uint16_t)(chip8->I + index)] = V[entry->X + direction * index];
+    }
+
+    mark_ram_dirty(chip8, chip8->I, chip8->I + distance);
+    invalidate_range(threaded, chip8->I, distance + 1);
+    DISPATCH();
+}
+
+op_interpret:
+    chip8->program_counter = pc - 2;
+    emulate_instruction(chip8);
+    pc = chip8->program_counter;
+    DISPATCH();
+
+done:
+    chip8->program_counter = pc;
+}
@@ -0,0 +1,352 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define TRACE_PC_NEXT 0x00
+#define TRACE_PC_SAME 0x01
+#define TRACE_PC_EXPLICIT 0x02
+#define TRACE_PC_MASK 0x03
+#define TRACE_OPCODE 0x04
+#define TRACE_I 0x08
+#define TRACE_VX 0x10
+#define TRACE_VF 0x20
+
+static const uint8_t trace_magic[4] = {'C', '8', 'T', 'R'};
+
+static void put_u16(uint8_t *bytes, uint16_t value)
+{
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value)
+{
+    put_u16(bytes, value & 0xFFFF);
+    put_u16(bytes + 2, value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *bytes)
+{
+    return get_u16(bytes) | ((uint32_t)get_u16(bytes + 2) << 16);
+}
+
+static uint32_t encode_record(trace_codec_object *codec, const trace_record_object *record, uint8_t *bytes)
+{
+    const uint8_t X = (record->opcode >> 8) & 0x0F;
+    uint32_t used = 1;
+    uint8_t flags = TRACE_PC_EXPLICIT;
+
+    if (record->program_counter == (uint16_t)(codec->program_counter + 2)) {
+        flags = TRACE_PC_NEXT;
+    } else if (record->program_counter == codec->program_counter) {
+        flags = TRACE_PC_SAME;
+    } else {
+        put_u16(bytes + used, record->program_counter);
+        used += 2;
+    }
+
+    if (record->opcode != codec->opcodes[record->program_counter]) {
+        flags |= TRACE_OPCODE;
+        put_u16(bytes + used, record->opcode);
+        used += 2;
+    }
+
+    if (record->I != codec->I) {
+        flags |= TRACE_I;
+        put_u16(bytes + used, record->I);
+        used += 2;
+    }
+
+    if (record->VX != codec->V[X]) {
+        flags |= TRACE_VX;
+        bytes[used++] = record->VX;
+    }
+
+    codec->V[X] = record->VX;
+
+    if (record->VF != codec->V[0xF]) {
+        flags |= TRACE_VF;
+        bytes[used++] = record->VF;
+    }
+
+    codec->V[0xF] = record->VF;
+    codec->opcodes[record->program_counter] = record->opcode;
+    codec->program_counter = record->program_counter;
+    codec->I = record->I;
+    bytes[0] = flags;
+
+    return used;
+}
+
+static bool decode_record(trace_codec_object *codec, const uint8_t *bytes, uint32_t size, uint32_t *offset, trace_record_object *record)
+{
+    if (*offset >= size) {
+        return false;
+    }
+
+    const uint8_t flags = bytes[(*offset)++];
+    const uint32_t needed = ((flags & TRACE_PC_MASK) == TRACE_PC_EXPLICIT ? 2 : 0)
+        + ((flags & TRACE_OPCODE) ? 2 : 0)
+        + ((flags & TRACE_I) ? 2 : 0)
+        + ((flags & TRACE_VX) ? 1 : 0)
+        + ((flags & TRACE_VF) ? 1 : 0);
+
+    if ((flags & TRACE_PC_MASK) > TRACE_PC_EXPLICIT || size - *offset < needed) {
+        return false;
+    }
+
+    switch (flags & TRACE_PC_MASK)
+    {
+        case TRACE_PC_NEXT:
+            record->program_counter = codec->program_counter + 2;
+            break;
+
+        case TRACE_PC_SAME:
+            record->program_counter = codec->program_counter;
+            break;
+
+        default:
+            record->program_counter = get_u16(bytes + *offset);
+            *offset += 2;
+            break;
+    }
+
+    record->opcode = codec->opcodes[record->program_counter];
+
+    if (flags & TRACE_OPCODE) {
+        record->opcode = get_u16(bytes + *offset);
+        *offset += 2;
+    }
+
+    record->I = codec->I;
+
+    if (flags & TRACE_I) {
+        record->I = get_u16(bytes + *offset);
+        *offset += 2;
+    }
+
+    const uint8_t X = (record->opcode >> 8) & 0x0F;
+    record->VX = (flags & TRACE_VX) ? bytes[(*offset)++] : codec->V[X];
+    codec->V[X] = record->VX;
+    record->VF = (flags & TRACE_VF) ? bytes[(*offset)++] : codec->V[0xF];
+    codec->V[0xF] = record->VF;
+
+    codec->opcodes[record->program_counter] = record->opcode;
+    codec->program_counter = record->program_counter;
+    codec->I = record->I;
+
+    return true;
+}
+
+static void write_trace_block(trace_object *trace, uint32_t tail, uint32_t count)
+{
+    uint32_t size = 0;
+
+    for (uint32_t index = 0; index < count; index++) {
+        const trace_record_object *record = &trace->records[(tail + index) % TRACE_RING_RECORDS];
+        size += encode_record(&trace->codec, record, trace->block + size);
+    }
+
+    uint8_t header[8];
+    put_u32(header, count);
+    put_u32(header + 4, size);
+
+    if (!trace->failed
+        && (fwrite(header, sizeof header, 1, trace->file) != 1 || fwrite(trace->block, size, 1, trace->file) != 1)) {
+        fprintf(stderr, "Could not write trace block\n");
+        trace->failed = true;
+    }
+
+    trace->records_written += count;
+    trace->bytes_written += sizeof header + size;
+}
+
+static void *run_flusher(void *argument)
+{
+    trace_object *trace = argument;
+    uint32_t tail = 0;
+
+    for (;;) {
+        const bool stopping = atomic_load_explicit(&trace->stopping, memory_order_acquire);
+        const uint32_t published = atomic_load_explicit(&trace->published, memory_order_acquire);
+
+        if (published == tail) {
+            if (stopping) {
+                break;
+            }
+
+            nanosleep(&(struct timespec){.tv_nsec = TRACE_FLUSH_WAIT_US * 1000}, NULL);
+            continue;
+        }
+
+        uint32_t count = published - tail;
+
+        if (count > TRACE_BLOCK_RECORDS) {
+            count = TRACE_BLOCK_RECORDS;
+        }
+
+        write_trace_block(trace, tail, count);
+        tail += count;
+        atomic_store_explicit(&trace->tail, tail, memory_order_release);
+    }
+
+    return NULL;
+}
+
+void wait_trace_space(trace_object *trace)
+{
+    atomic_store_explicit(&trace->published, trace->head, memory_order_release);
+
+    for (;;) {
+        trace->tail_seen = atomic_load_explicit(&trace->tail, memory_order_acquire);
+
+        if (trace->head - trace->tail_seen < TRACE_RING_RECORDS) {
+            return;
+        }
+
+        trace->stalls++;
+        sched_yield();
+    }
+}
+
+bool start_trace(trace_object *trace, const char *path, const chip8_object *chip8)
+{
+    FILE *file = fopen(path, "wb");
+
+    if (!file) {
+        fprintf(stderr, "Could not create trace %s\n", path);
+        return false;
+    }
+
+    const char *rom_name = chip8->rom_name ? chip8->rom_name : "";
+    const size_t name_length = strnlen(rom_name, 255);
+    uint8_t header[8];
+
+    memcpy(header, trace_magic, sizeof trace_magic);
+    put_u16(header + 4, TRACE_VERSION);
+    header[6] = (uint8_t)chip8->quirks;
+    header[7] = (uint8_t)name_length;
+
+    if (fwrite(header, sizeof header, 1, file) != 1 || fwrite(rom_name, 1, name_length, file) != name_length) {
+        fprintf(stderr, "Could not write trace %s\n", path);
+        fclose(file);
+        return false;
+    }
+
+    memset(&trace->codec, 0, sizeof trace->codec);
+    trace->head = 0;
+    trace->tail_seen = 0;
+    trace->stalls = 0;
+    trace->records_written = 0;
+    trace->bytes_written = sizeof header + name_length;
+    trace->failed = false;
+    trace->file = file;
+    atomic_init(&trace->published, 0);
+    atomic_init(&trace->tail, 0);
+    atomic_init(&trace->stopping, false);
+
+    if (pthread_create(&trace->flusher, NULL, run_flusher, trace) != 0) {
+        fprintf(stderr, "Could not start trace flusher\n");
+        fclose(file);
+        return false;
+    }
+
+    return true;
+}
+
+bool stop_trace(trace_object *trace)
+{
+    atomic_store_explicit(&trace->published, trace->head, memory_order_release);
+    atomic_store_explicit(&trace->stopping, true, memory_order_release);
+    pthread_join(trace->flusher, NULL);
+
+    if (fclose(trace->file) != 0) {
+        fprintf(stderr, "Could not close trace\n");
+        trace->failed = true;
+    }
+
+    trace->file = NULL;
+    return !trace->failed;
+}
+
+bool open_trace(trace_reader_object *reader, const char *path)
+{
+    memset(reader, 0, sizeof *reader);
+    reader->file = fopen(path, "rb");
+
+    if (!reader->file) {
+        fprintf(stderr, "Trace %s is invalid or does not exist\n", path);
+        return false;
+    }
+
+    uint8_t header[8];
+
+    if (fread(header, sizeof header, 1, reader->file) != 1
+        || memcmp(header, trace_magic, sizeof trace_magic) != 0
+        || get_u16(header + 4) != TRACE_VERSION
+        || header[6] >= QUIRKS_COUNT
+        || fread(reader->rom_name, 1, header[7], reader->file) != header[7]) {
+        fprintf(stderr, "Trace %s is invalid or does not exist\n", path);
+        fclose(reader->file);
+        reader->file = NULL;
+        return false;
+    }
+
+    reader->quirks = (quirk_profile)header[6];
+    return true;
+}
+
+bool read_trace(trace_reader_object *reader, trace_record_object *record)
+{
+    if (reader->corrupt) {
+        return false;
+    }
+
+    while (reader->cursor == reader->block_records) {
+        uint8_t header[8];
+        const size_t header_size = fread(header, 1, sizeof header, reader->file);
+
+        if (header_size != sizeof header) {
+            reader->corrupt = header_size != 0;
+            return false;
+        }
+
+        reader->block_records = get_u32(header);
+        reader->block_size = get_u32(header + 4);
+        reader->cursor = 0;
+        reader->offset = 0;
+
+        if (reader->block_records > TRACE_BLOCK_RECORDS
+            || reader->block_size > sizeof reader->block
+            || fread(reader->block, 1, reader->block_size, reader->file) != reader->block_size) {
+            reader->corrupt = true;
+            return false;
+        }
+    }
+
+    if (!decode_record(&reader->codec, reader->block, reader->block_size, &reader->offset, record)) {
+        reader->corrupt = true;
+        return false;
+    }
+
+    reader->cursor++;
+    reader->index++;
+    return true;
+}
+
+void close_trace(trace_reader_object *reader)
+{
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
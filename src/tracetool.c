@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define TRACE_CONTEXT_MAX 64
+
+typedef struct {
+    uint16_t first_address;
+    uint16_t last_address;
+    uint16_t opcode_mask;
+    uint16_t opcode_value;
+} trace_filter_object;
+
+typedef struct {
+    trace_record_object record;
+    uint64_t index;
+} indexed_record_object;
+
+static bool parse_address_range(const char *text, trace_filter_object *filter)
+{
+    char *end = NULL;
+    const unsigned long first = strtoul(text, &end, 16);
+    unsigned long last = first;
+
+    if (end == text) {
+        return false;
+    }
+
+    if (*end == '-') {
+        const char *second = end + 1;
+        last = strtoul(second, &end, 16);
+
+        if (end == second) {
+            return false;
+        }
+    }
+
+    if (*end != '\0' || first > last || last >= MEMORY_SIZE) {
+        return false;
+    }
+
+    filter->first_address = (uint16_t)first;
+    filter->last_address = (uint16_t)last;
+    return true;
+}
+
+static bool parse_opcode_pattern(const char *text, trace_filter_object *filter)
+{
+    if (strlen(text) != 4) {
+        return false;
+    }
+
+    filter->opcode_mask = 0;
+    filter->opcode_value = 0;
+
+    for (int index = 0; index < 4; index++) {
+        const char digit = text[index];
+        const int shift = 12 - index * 4;
+
+        if (digit == 'x' || digit == 'X' || digit == '.') {
+            continue;
+        }
+
+        const char hex[2] = {digit, '\0'};
+        char *end = NULL;
+        const unsigned long value = strtoul(hex, &end, 16);
+
+        if (*end != '\0') {
+            return false;
+        }
+
+        filter->opcode_mask |= 0xF << shift;
+        filter->opcode_value |= value << shift;
+    }
+
+    return true;
+}
+
+static bool matches_filter(const trace_filter_object *filter, const trace_record_object *record)
+{
+    return record->program_counter >= filter->first_address
+        && record->program_counter <= filter->last_address
+        && (record->opcode & filter->opcode_mask) == filter->opcode_value;
+}
+
+static bool read_filtered(trace_reader_object *reader, const trace_filter_object *filter, indexed_record_object *entry)
+{
+    while (read_trace(reader, &entry->record)) {
+        if (matches_filter(filter, &entry->record)) {
+            entry->index = reader->index - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void print_record(char marker, const indexed_record_object *entry)
+{
+    const trace_record_object *record = &entry->record;
+
+    printf("%c%12llu %04X %04X I=%04X V%X=%02X VF=%02X\n",
+        marker,
+        (unsigned long long)entry->index,
+        record->program_counter,
+        record->opcode,
+        record->I,
+        (record->opcode >> 8) & 0x0F,
+        record->VX,
+        record->VF);
+}
+
+static bool records_equal(const trace_record_object *left, const trace_record_object *right)
+{
+    return left->program_counter == right->program_counter
+        && left->opcode == right->opcode
+        && left->I == right->I
+        && left->VX == right->VX
+        && left->VF == right->VF;
+}
+
+static int decode_trace(trace_reader_object *reader, const trace_filter_object *filter, uint64_t skip, uint64_t limit)
+{
+    indexed_record_object entry;
+    uint64_t shown = 0;
+
+    while ((limit == 0 || shown < limit) && read_filtered(reader, filter, &entry)) {
+        if (skip > 0) {
+            skip--;
+            continue;
+        }
+
+        print_record(' ', &entry);
+        shown++;
+    }
+
+    fprintf(stderr, "%llu records read, %llu shown\n", (unsigned long long)reader->index, (unsigned long long)shown);
+    return reader->corrupt ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int diff_traces(trace_reader_object *left, trace_reader_object *right, const trace_filter_object *filter, uint32_t context)
+{
+    indexed_record_object history[TRACE_CONTEXT_MAX];
+    indexed_record_object left_entry;
+    indexed_record_object right_entry;
+    uint64_t compared = 0;
+
+    for (;;) {
+        const bool has_left = read_filtered(left, filter, &left_entry);
+        const bool has_right = read_filtered(right, filter, &right_entry);
+
+        if (!has_left && !has_right) {
+            if (left->corrupt || right->corrupt) {
+                printf("Trace is corrupt after %llu matching records\n", (unsigned long long)compared);
+                return EXIT_FAILURE;
+            }
+
+            printf("Traces match over %llu records\n", (unsigned long long)compared);
+            return EXIT_SUCCESS;
+        }
+
+        if (has_left && has_right && records_equal(&left_entry.record, &right_entry.record)) {
+            if (context > 0) {
+                history[compared % context] = left_entry;
+            }
+            compared++;
+            continue;
+        }
+
+        printf("Traces diverge after %llu matching records\n", (unsigned long long)compared);
+
+        const uint64_t shown = compared < context ? compared : context;
+
+        for (uint64_t index = compared - shown; index < compared; index++) {
+            print_record(' ', &history[index % context]);
+        }
+
+        if (has_left) {
+            print_record('<', &left_entry);
+        } else {
+            printf("< end of trace\n");
+        }
+
+        if (has_right) {
+            print_record('>', &right_entry);
+        } else {
+            printf("> end of trace\n");
+        }
+
+        return EXIT_FAILURE;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        printf("Usage: %s <trace> [--diff TRACE] [--pc ADDRESS[-ADDRESS]] [--opcode PATTERN]\n"
+               "       [--skip N] [--count N] [--context N]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    trace_filter_object filter = {.last_address = MEMORY_SIZE - 1};
+    const char *diff = NULL;
+    uint64_t skip = 0;
+    uint64_t limit = 0;
+    uint32_t context = 8;
+
+    for (int index = 2; index < argc; index++) {
+        if (strcmp(argv[index], "--diff") == 0 && index + 1 < argc) {
+            diff = argv[++index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--pc") == 0 && index + 1 < argc) {
+            if (!parse_address_range(argv[++index], &filter)) {
+                printf("Invalid address range %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[index], "--opcode") == 0 && index + 1 < argc) {
+            if (!parse_opcode_pattern(argv[++index], &filter)) {
+                printf("Invalid opcode pattern %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[index], "--skip") == 0 && index + 1 < argc) {
+            if (!parse_count(argv[++index], 0, UINT64_MAX, &skip)) {
+                printf("Invalid skip count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[index], "--count") == 0 && index + 1 < argc) {
+            if (!parse_count(argv[++index], 0, UINT64_MAX, &limit)) {
+                printf("Invalid record count %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[index], "--context") == 0 && index + 1 < argc) {
+            uint64_t lines = 0;
+
+            if (!parse_count(argv[++index], 0, TRACE_CONTEXT_MAX, &lines)) {
+                printf("Invalid context length %s\n", argv[index]);
+                exit(EXIT_FAILURE);
+            }
+            context = (uint32_t)lines;
+            continue;
+        }
+
+        printf("Unknown option %s\n", argv[index]);
+        exit(EXIT_FAILURE);
+    }
+
+    static trace_reader_object left;
+    static trace_reader_object right;
+
+    if (!open_trace(&left, argv[1])) {
+        exit(EXIT_FAILURE);
+    }
+
+    printf("rom: %s quirks: %s\n", left.rom_name, quirk_profile_name(left.quirks));
+
+    if (!diff) {
+        const int status = decode_trace(&left, &filter, skip, limit);
+        close_trace(&left);
+        exit(status);
+    }
+
+    if (!open_trace(&right, diff)) {
+        close_trace(&left);
+        exit(EXIT_FAILURE);
+    }
+
+    if (strcmp(left.rom_name, right.rom_name) != 0 || left.quirks != right.quirks) {
+        printf("rom: %s quirks: %s\n", right.rom_name, quirk_profile_name(right.quirks));
+    }
+
+    const int status = diff_traces(&left, &right, &filter, context);
+    close_trace(&left);
+    close_trace(&right);
+    exit(status);
+}